@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "tracer.skel.h"
+
+struct bpf_provider_options;
+
+// Statistics of a program collected by the kernel since the programs were loaded
+struct program_stats {
+  std::string name;
+  uint64_t run_count;
+  uint64_t run_time_ns;
+  // Invocations by tasks which are not traced, for programs which check it
+  std::optional<uint64_t> untraced;
+};
+
+/**
+ * BPF programs loaded and attached for the lifetime of the object,
+ * together with the ring buffer they send their records to.
+ */
+class bpf_programs {
+  tracer *skel;
+  ring_buffer *buffer;
+  // Keeps the run time statistics enabled
+  int stats_fd = -1;
+  // Flush the staged writes of every cpu
+  std::vector<bpf_link *> flush_ticks;
+
+  // False when the timer of a cpu cannot be attached
+  bool attach_flush_ticks(std::chrono::nanoseconds stage_flush);
+  void release();
+
+ public:
+  using sample_function = int (*)(void *ctx, void *data, size_t len);
+
+  // Every record is passed to sample together with ctx
+  bpf_programs(bpf_provider_options const& options, sample_function sample, void *ctx);
+  ~bpf_programs();
+  bpf_programs(bpf_programs const&) = delete;
+  bpf_programs& operator=(bpf_programs const&) = delete;
+
+  // Waits up to timeout milliseconds for records
+  void poll(int timeout);
+  // Readable when there are records to poll
+  int epoll_fd() const;
+  // Bytes of records waiting in the ring buffer
+  size_t available_bytes() const;
+  int processes_fd() const;
+  // Records of all sessions which did not fit into the ring buffer since the programs were loaded
+  uint64_t dropped_events() const;
+
+  // Empty unless program_stats was requested, programs which are not loaded are left out
+  std::vector<program_stats> program_statistics() const;
+
+  // Uses the current standard output and error of the process as the descriptors of the session
+  void resolve_descriptors(pid_t pid, uint32_t session);
+  // Stops tracing the processes of the session and forgets its descriptors
+  void end_session(uint32_t session);
+
+  // Pins the processes map, so that other processes can register commands to trace
+  void pin(std::filesystem::path const& directory);
+  void unpin(std::filesystem::path const& directory);
+};
+
+void print_program_stats(std::ostream& os, std::vector<program_stats> const& stats);
+
+// Session of a run which loads the programs itself
+constexpr uint32_t LOCAL_SESSION = 1;
+
+// Marks the process as traced in the session, must be called before it executes the command.
+// Returns false if the process was already traced.
+bool trace_process(int processes_fd, pid_t pid, uint32_t session);
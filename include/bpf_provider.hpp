@@ -1,29 +1,104 @@
 #pragma once
 
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
 #include <optional>
 #include <queue>
 #include <set>
 #include <thread>
+#include <vector>
 #include <atomic>
 
 #include <boost/lockfree/spsc_queue.hpp>
 
+#include "event_decoder.hpp"
+#include "event_provider.hpp"
 #include "events.hpp"
-#include "tracer.skel.h"
 
-class bpf_provider {
+namespace backend {
+struct write_event;
+}
+
+class bpf_programs;
+class pipeline_stats;
+struct program_stats;
+struct process_snapshot;
+
+struct bpf_provider_options {
+  // Attach scheduler probes and report CPU time and runqueue latency of every exiting process
+  bool profile_scheduling = false;
+  // Consecutive writes of a process to the same descriptor are merged into one event
+  // when each of them follows the previous one within this window, zero disables merging.
+  // The merged event keeps the timestamp of its first write, so writes separated
+  // by longer pauses keep their own timestamps.
+  std::chrono::nanoseconds coalesce_window{0};
+  // Merged writes do not grow beyond this many bytes
+  size_t coalesce_limit = 16 * 1024;
+  // Small writes are staged in the kernel and sent in batches, which saves ring buffer records
+  // and wakeups. A batch is sent as one write with the timestamp of its first write.
+  bool stage_writes = false;
+  // Staged writes are sent once the first of them is this long ago, before the next write
+  // or on a timer of the cpu, which fires every half of this, so they wait up to 1.5 times this long
+  std::chrono::nanoseconds stage_flush{std::chrono::milliseconds{10}};
+  // Run time statistics of the BPF programs are collected by the kernel and reported at exit.
+  // The kernel measures all BPF programs on the machine while they are enabled.
+  bool program_stats = false;
+  // Events are received from the daemon listening on this socket instead of loading the BPF programs.
+  // The options of the BPF programs are then the ones the daemon was started with.
+  std::optional<std::filesystem::path> daemon_socket;
+  // The records are also saved to this file as they arrive, so that the run can be replayed
+  std::optional<std::filesystem::path> record;
+  // Measurements of the pipeline are recorded here when set, owned by the caller
+  pipeline_stats *stats = nullptr;
+};
+
+class bpf_provider : public events::event_provider {
  public:
-  bpf_provider();
+  bpf_provider(bpf_provider_options options = {});
   ~bpf_provider();
   void run(char *argv[]);
-  bool is_active();
-  std::optional<events::event> provide();
+  // Traces a running process and its descendants, starting with an exec event of each of them
+  void attach(pid_t pid);
+  bool is_active() override;
+  std::optional<events::event> provide() override;
+  // Statistics of the BPF programs when tracing ended, empty unless program_stats was requested
+  // and the programs were loaded by the provider
+  std::vector<program_stats> const& program_statistics() const { return final_program_stats; }
 
  private:
+  struct pending_write {
+    events::write_event event;
+    // Raw timestamp of the last merged write
+    uint64_t last_timestamp;
+  };
+
   void main_loop();
+  void connect_to_daemon(std::filesystem::path const& socket_path);
+  // Waits up to timeout milliseconds for records
+  void poll(int timeout);
+  void receive_from_daemon(int timeout);
   static int buf_process_sample(void *ctx, void *data, size_t len);
-  tracer *skel;
-  ring_buffer *buffer;
+  events::exec_event from(process_snapshot const& process, events::time_point timestamp);
+  // Traces an attached process unless it is already traced or it exited before it was registered
+  bool register_process(pid_t pid);
+  void push(events::event e);
+  void push_write(const backend::write_event *e);
+  void flush_pending_write();
+  // Flushes the pending write when no other write joined it within the window
+  void flush_expired_write();
+  bpf_provider_options options;
+  event_decoder decoder;
+  std::ofstream recording;
+  std::optional<pending_write> pending;
+  // Either the programs are loaded by the provider or their records come from the daemon
+  std::unique_ptr<bpf_programs> programs;
+  std::vector<program_stats> final_program_stats;
+  int daemon = -1;
+  bool disconnected = false;
+  int processes_fd;
+  uint32_t session;
   std::thread receiver_thread;
   std::queue<events::event> messages;
   std::atomic<bool> active;
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+/**
+ * Output stream writing a gzip file.
+ * Data is gathered in large blocks which are compressed and written by a background
+ * thread shared by all compressed streams, so writing costs about as much as a copy.
+ *
+ * The file is opened by the background thread when the first block arrives, which
+ * happens after the privileges are dropped. Blocks of all streams are processed in order,
+ * so a file can be reopened and rewritten while its previous contents are still pending.
+ * flush() does not force the data out, the file is complete once the stream is destroyed.
+ *
+ * A stream holds a block only after its first write and a compression state only between
+ * its first block and its destruction, long-lived streams should be destroyed when done.
+ */
+class compressed_ostream : public std::ostream {
+ public:
+  struct target;
+
+ private:
+  class block_buffer : public std::streambuf {
+    std::shared_ptr<target> file;
+    std::string block;
+
+    void submit(bool finish);
+    // Submits the current block, if any, and starts a new one
+    void next_block();
+
+   public:
+    block_buffer(std::filesystem::path path, bool append);
+    ~block_buffer();
+
+   protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(char const* data, std::streamsize count) override;
+  };
+
+  block_buffer buffer;
+
+ public:
+  // Appending adds a gzip member to the file
+  compressed_ostream(std::filesystem::path path, bool append = false);
+  // Waits until the blocks of all destroyed streams are written out
+  static void wait_for_pending();
+};
+
+// Opens a file for writing, compressed with gzip if requested
+std::unique_ptr<std::ostream> open_output_file(std::filesystem::path const& path, bool compress, bool append = false);
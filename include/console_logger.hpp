@@ -2,10 +2,12 @@
 
 #include "event_consumer.hpp"
 #include "structure/plain/plain_event_formatter.hpp"
+#include "terminal_lines.hpp"
 
 class console_logger : public events::event_consumer {
   struct event_visitor {
     plain_event_formatter fmt;
+    terminal_lines lines{[this](events::write_event const& e) { fmt.format(std::cout, e); }};
 
     void operator()(events::fork_event const& e);
     void operator()(events::exec_event const& e);
@@ -17,4 +19,7 @@ class console_logger : public events::event_consumer {
 
  public:
   void consume(events::event const&);
+  // Output is written in large blocks, flush when there are no pending events
+  void flush();
+  ~console_logger();
 };
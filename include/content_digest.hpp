@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "events.hpp"
+
+/**
+ * Streaming XXH64, the data can be passed in pieces of any size.
+ * The digest equals the one of the reference implementation for the whole data.
+ */
+class xxh64 {
+  uint64_t accumulators[4];
+  uint64_t seed;
+  uint64_t length = 0;
+  // Input not yet consumed by a full stripe of 32 bytes
+  unsigned char buffer[32];
+  size_t buffered = 0;
+
+  void consume_stripe(unsigned char const *data);
+
+ public:
+  xxh64(uint64_t seed = 0);
+  void update(void const *data, size_t size);
+  void update(std::string_view data) { update(data.data(), data.size()); }
+  // Does not change the state, more data can follow
+  uint64_t digest() const;
+};
+
+/**
+ * Digest of the output of a program (exec group), which stays the same when the program
+ * prints the same output in another run.
+ *
+ * The output is normalized before it is hashed: every (process, descriptor) stream is
+ * hashed on its own, so the interleaving of concurrent processes and of the standard
+ * output and error does not matter, and a line redrawn with carriage returns counts with
+ * the text after its last carriage return, as a progress bar ends up on a terminal.
+ * The digests of the streams are summed, in whatever order their processes exit.
+ * Pids are left out, they differ in every run.
+ *
+ * Only an unfinished line is buffered for every stream, the rest is hashed as it is written.
+ * A line longer than MAX_LINE is hashed in pieces, a carriage return after that only
+ * redraws the text that follows the last piece.
+ */
+class output_digest {
+  struct stream {
+    xxh64 hash;
+    std::string line;
+    // A carriage return was the last character, the line is overwritten unless a newline follows
+    bool carriage_return = false;
+
+    stream(events::write_event::descriptor fd) : hash(static_cast<uint64_t>(fd)) {}
+  };
+
+  std::unordered_map<uint64_t, stream> streams;
+  // Sum of the digests of the streams of exited processes
+  uint64_t finished = 0;
+  uint64_t elided = 0;
+
+  void finish(uint64_t key);
+
+ public:
+  static constexpr size_t MAX_LINE = 64 * 1024;
+
+  void write(events::write_event const& e);
+  // Output left out by the output budget counts with its size
+  void elide(size_t bytes) { elided += bytes; }
+  // Finishes the streams of the process
+  void exit(pid_t pid);
+  // Finishes all streams and combines them with the program and its exit code
+  uint64_t digest(events::exec_event const& program, std::optional<int> exit_code);
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace daemon_protocol {
+inline const std::filesystem::path DEFAULT_SOCKET = "/run/anteater.sock";
+inline const std::filesystem::path PIN_DIRECTORY = "/sys/fs/bpf/anteater";
+
+constexpr uint32_t MAGIC = 0x616e7465;
+constexpr uint32_t VERSION = 3;
+// Records of the BPF programs are sent one per message and are never larger
+constexpr size_t MAX_RECORD_SIZE = 8192;
+
+// First message sent to a client, the records of its session follow
+struct ready {
+  uint32_t magic = MAGIC;
+  uint32_t version = VERSION;
+  // Value the client registers its command with in the pinned processes map
+  uint32_t session;
+};
+}  // namespace daemon_protocol
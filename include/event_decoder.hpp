@@ -0,0 +1,52 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+
+#include "events.hpp"
+
+namespace backend {
+struct fork_event;
+struct exec_event;
+struct exit_event;
+struct write_event;
+union event;
+}
+
+/**
+ * Converts the records sent by the BPF programs into events.
+ * A decoder keeps the state of a single session: the paths of the working
+ * directories sent by earlier execs and the names of the users seen so far.
+ */
+class event_decoder {
+  events::time_point boot_time;
+  std::map<std::tuple<uint64_t, uint64_t, uint64_t, uint64_t>, std::string_view> working_directories;
+  std::unordered_map<uid_t, std::string_view> user_names;
+  // reused so that repeated commands do not allocate
+  std::string command;
+
+ public:
+  // Timestamps of the records are relative to the boot time
+  event_decoder(events::time_point boot_time = current_boot_time());
+  static events::time_point current_boot_time();
+  events::time_point boot() const { return boot_time; }
+
+  events::time_point timestamp(uint64_t record_timestamp) const;
+  std::string_view user_name(uid_t uid);
+
+  events::fork_event decode(backend::fork_event const *e);
+  events::exec_event decode(backend::exec_event const *e);
+  events::exit_event decode(backend::exit_event const *e);
+  events::write_event decode(backend::write_event const *e);
+  // Record of any type
+  events::event decode(backend::event const *e);
+  // The record has a known type and holds all the data its sizes refer to,
+  // records of the BPF programs always do, the ones read from a file need not
+  static bool valid(void const *record, size_t size);
+};
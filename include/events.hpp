@@ -1,8 +1,11 @@
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <optional>
+#include <string_view>
 #include <variant>
 
 // events used in the client written in CPP
@@ -18,15 +21,38 @@ struct fork_event : event_base {
   pid_t child_pid;
 };
 
+// Strings of exec events are interned in events::string_pool::global()
 struct exec_event : event_base {
   uid_t user_id;
-  std::string user_name;
-  std::string working_directory;
-  std::string command;
+  std::string_view user_name;
+  std::string_view working_directory;
+  std::string_view command;
+};
+
+constexpr size_t runqueue_histogram_buckets = 20;
+
+// Scheduler accounting of a process, reported on exit when scheduler profiling is enabled
+struct sched_stats {
+  std::chrono::nanoseconds on_cpu{0};
+  // Time not running, including the time spent in runqueue
+  std::chrono::nanoseconds off_cpu{0};
+  std::chrono::nanoseconds runqueue{0};
+  // Bucket i counts runqueue waits in [2^i, 2^(i+1)) microseconds
+  std::array<uint32_t, runqueue_histogram_buckets> runqueue_histogram{};
+
+  sched_stats& operator+=(sched_stats const& other) {
+    on_cpu += other.on_cpu;
+    off_cpu += other.off_cpu;
+    runqueue += other.runqueue;
+    for (size_t i = 0; i < runqueue_histogram_buckets; i++)
+      runqueue_histogram[i] += other.runqueue_histogram[i];
+    return *this;
+  }
 };
 
 struct exit_event : event_base {
   int exit_code;
+  std::optional<sched_stats> sched;
 };
 
 struct write_event : event_base {
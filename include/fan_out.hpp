@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "event_consumer.hpp"
+#include "events.hpp"
+#include "structure/output_budget.hpp"
+
+/**
+ * Delivers every event to several output backends, each running on its own thread.
+ * An event is stored once and shared by the backends, which only read it.
+ *
+ * Every backend has a bounded queue, so that a slow backend does not hold up the others
+ * or the ring buffer: when its queue is full, writes are dropped for that backend and
+ * counted, the drops are reported when the fan-out is destroyed. Fork, exec and exit events
+ * shape the structure of the logs, they are kept in an unbounded backlog of the backend
+ * instead, which is moved to its queue in order as room frees up.
+ * The dropped output of every process is passed on where it went missing, as an
+ * output_elided with the pid, to backends with consume(pid_t, output_elided const&).
+ *
+ * A backend is created and destroyed on its own thread, which inherits the privileges
+ * of the thread adding it. It is flushed whenever its queue runs empty, if it has a flush().
+ */
+class fan_out : public events::event_consumer {
+  using shared_event = std::shared_ptr<events::event const>;
+
+  // Writes of a process dropped for a backend
+  struct elided_writes {
+    pid_t source_pid;
+    output_elided elided;
+  };
+  using item = std::variant<shared_event, elided_writes>;
+
+  struct channel {
+    std::string name;
+    boost::lockfree::spsc_queue<item> queue;
+    // Incremented after every push, the backend waits for it to change
+    std::atomic<uint64_t> pushed = 0;
+    std::atomic<bool> closed = false;
+    // The backend threw, it gets no more events
+    std::atomic<bool> failed = false;
+    uint64_t dropped_writes = 0;
+    // Items which did not fit into the queue, in order, only used by the producer
+    std::deque<item> backlog;
+    // Writes of every process dropped since the last item of the backlog
+    std::map<pid_t, output_elided> elided;
+    std::thread worker;
+
+    channel(std::string name, size_t capacity) : name(std::move(name)), queue(capacity) {}
+  };
+
+  size_t capacity;
+  std::vector<std::unique_ptr<channel>> channels;
+
+  static void report_failure(channel const& c, std::exception const& e);
+  static bool push(channel& c, item const& i);
+  // Moves the backlog and the dropped writes to the queue, false when it fills up first
+  static bool drain(channel& c);
+
+  template <class Consumer>
+  static void run(channel& c, Consumer& consumer) {
+    uint64_t seen = 0;
+    item e;
+    while (true) {
+      while (c.queue.pop(e)) {
+        if (auto event = std::get_if<shared_event>(&e)) {
+          consumer.consume(**event);
+        } else if constexpr (requires { consumer.consume(pid_t{}, output_elided{}); }) {
+          auto const& writes = std::get<elided_writes>(e);
+          consumer.consume(writes.source_pid, writes.elided);
+        }
+        seen++;
+      }
+      e = shared_event{};
+      if constexpr (requires { consumer.flush(); })
+        consumer.flush();
+      if (c.closed && c.queue.read_available() == 0)
+        return;
+      c.pushed.wait(seen);
+    }
+  }
+
+ public:
+  // Backends queue up to capacity events unless they are added with their own capacity
+  fan_out(size_t capacity = 64 * 1024);
+  // Waits until the backends consume their queues and destroys them
+  ~fan_out();
+
+  // make creates the backend, a consumer of events, on its thread
+  template <class Make>
+  void add(std::string name, Make make, std::optional<size_t> queue_capacity = {}) {
+    auto& c = *channels.emplace_back(std::make_unique<channel>(std::move(name), queue_capacity.value_or(capacity)));
+    c.worker = std::thread{[&c, make = std::move(make)] {
+      try {
+        auto consumer = make();
+        run(c, *consumer);
+      } catch (std::exception const& e) {
+        c.failed = true;
+        report_failure(c, e);
+      }
+    }};
+  }
+
+  void consume(events::event e);
+};
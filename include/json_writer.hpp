@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * Minimal streaming JSON writer.
+ * Output is gathered in a reusable buffer and written to the stream in large blocks,
+ * so writing a document does not allocate once the buffer has grown.
+ *
+ * The writer inserts commas on its own but does not validate the structure,
+ * the caller is responsible for matching begin and end calls.
+ */
+class json_writer {
+  std::ostream& os;
+  std::string buffer;
+  bool need_comma = false;
+
+  void separate();
+  void write_escaped(std::string_view str);
+
+ public:
+  json_writer(std::ostream& os);
+  ~json_writer();
+
+  void begin_object();
+  void end_object();
+  void begin_array();
+  void end_array();
+  // Names are not escaped, they are expected to be plain identifiers
+  void key(std::string_view name);
+
+  void value(std::string_view str);
+  void value(char const* str) { value(std::string_view{str}); }
+  void value(int64_t number);
+  void value(uint64_t number);
+  void value(int number) { value(static_cast<int64_t>(number)); }
+  void value(unsigned number) { value(static_cast<uint64_t>(number)); }
+  void value(bool flag);
+  // Decimal number value / 10^decimals, written without going through floating point
+  void fixed_point(int64_t value, int decimals);
+
+  // Writes raw text between values, e.g. a newline in JSON Lines
+  void raw(std::string_view text);
+  // Writes out the buffer if it grew large, called between documents
+  void maybe_flush();
+  void flush();
+};
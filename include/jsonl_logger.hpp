@@ -0,0 +1,46 @@
+#pragma once
+
+#include <ostream>
+#include <unordered_map>
+
+#include "event_consumer.hpp"
+#include "json_writer.hpp"
+
+/**
+ * Writes every event as a single JSON object on its own line (JSON Lines),
+ * meant for ingestion by log pipelines.
+ *
+ * Every object carries the pid and ppid of the process and the id of its exec group.
+ * Each exec starts a new group, forked processes inherit the group of their parent.
+ * Timestamps are in nanoseconds since the epoch.
+ */
+class jsonl_logger : public events::event_consumer {
+  struct process_info {
+    pid_t ppid;
+    uint64_t group;
+  };
+
+  struct event_visitor {
+    jsonl_logger& logger;
+
+    void operator()(events::fork_event const& e);
+    void operator()(events::exec_event const& e);
+    void operator()(events::exit_event const& e);
+    void operator()(events::write_event const& e);
+  };
+
+  json_writer writer;
+  std::unordered_map<pid_t, process_info> processes;
+  uint64_t last_group = 0;
+  event_visitor visitor;
+
+  void begin(std::string_view type, events::event_base const& e, process_info const& info);
+  void end();
+
+ public:
+  jsonl_logger(std::ostream& os);
+  void consume(events::event const&);
+  // Output is written in large blocks, flush when there are no pending events
+  void flush();
+  ~jsonl_logger();
+};
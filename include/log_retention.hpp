@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "events.hpp"
+#include "run_journal.hpp"
+
+struct retention_policy {
+  std::optional<uintmax_t> max_total_bytes;
+  std::optional<std::chrono::hours> max_age;
+  std::optional<size_t> max_runs;
+  // Failed runs are never removed and do not count towards the limits
+  bool keep_failed = true;
+
+  bool enabled() const { return max_total_bytes.has_value() || max_age.has_value() || max_runs.has_value(); }
+};
+
+// Runs which exceed the policy, the newest runs are kept first
+std::vector<std::string> expired_runs(std::vector<run_info> runs, retention_policy const& policy, events::time_point now);
+
+/**
+ * Removes the runs exceeding the retention policy on a background thread with the lowest
+ * cpu and io priority, so that it does not slow down the traced program.
+ * Finished runs are read from the run journal, runs which are still running are never removed.
+ * The removed runs are compacted out of the journal, after which the index is rebuilt.
+ *
+ * The thread has to be started after the privileges are dropped. It is stopped between
+ * removals when the object is destroyed, the next run continues where it stopped.
+ */
+class log_retention {
+  std::filesystem::path logs_directory;
+  retention_policy policy;
+  std::function<void(run_journal const&)> rebuild_index;
+  std::atomic<bool> stopping = false;
+  std::thread worker;
+
+  void run();
+
+ public:
+  // rebuild_index is called with the journal locked after it was compacted
+  log_retention(
+    std::filesystem::path logs_directory,
+    retention_policy policy,
+    std::function<void(run_journal const&)> rebuild_index
+  );
+  ~log_retention();
+};
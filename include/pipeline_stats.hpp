@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include "events.hpp"
+
+/**
+ * Histogram with buckets of a constant relative width, as in HdrHistogram.
+ * Values below 2^SUB_BITS have their own bucket, every larger power of two
+ * is split into 2^SUB_BITS buckets, which keeps the error of a value below 1/2^SUB_BITS.
+ *
+ * A histogram has a single writer, any thread can summarize it meanwhile.
+ */
+class log_histogram {
+  static constexpr int SUB_BITS = 4;
+  static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+  std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+  std::atomic<uint64_t> total = 0;
+  std::atomic<uint64_t> maximum = 0;
+
+  static size_t bucket(uint64_t value);
+  // Largest value of the bucket
+  static uint64_t highest(size_t bucket);
+
+ public:
+  struct summary {
+    uint64_t count = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+  };
+
+  void record(uint64_t value) {
+    auto& count = counts[bucket(value)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (value > maximum.load(std::memory_order_relaxed))
+      maximum.store(value, std::memory_order_relaxed);
+  }
+  summary summarize() const;
+};
+
+/**
+ * Measurements of the pipeline taken while tracing. The receiver thread records the
+ * received records, the occupancy of the ring buffer and the depth of its message queue,
+ * the main thread the depth of the queue between the threads and the latency from the
+ * BPF timestamp of an event to its consumption.
+ *
+ * Every measurement is behind a pointer which is null when statistics are disabled.
+ */
+class pipeline_stats {
+ public:
+  // In the order of backend::event_type
+  enum record_type { FORK, EXIT, EXEC, WRITE, RECORD_TYPES };
+
+  struct counters {
+    std::array<uint64_t, RECORD_TYPES> records{};
+    std::array<uint64_t, RECORD_TYPES> bytes{};
+  };
+
+ private:
+  std::array<std::atomic<uint64_t>, RECORD_TYPES> records{};
+  std::array<std::atomic<uint64_t>, RECORD_TYPES> bytes{};
+  std::atomic<uint64_t> dropped = 0;
+  // Time point of the BPF timestamp 0, as the events are decoded
+  events::time_point clock_origin{};
+
+ public:
+  // Bytes waiting in the ring buffer before it is polled
+  log_histogram ring_occupancy;
+  // Events decoded by the receiver thread and not yet passed to the main thread
+  log_histogram messages_depth;
+  // Events waiting for the main thread
+  log_histogram queue_depth;
+  // Nanoseconds from the BPF timestamp of an event to its consumption,
+  // merged writes count from their first write
+  log_histogram latency;
+
+  // The BPF timestamps are CLOCK_MONOTONIC, the latency is measured on that clock
+  // from the timestamp recovered with the time point the decoder adds to them
+  void set_clock_origin(events::time_point origin) { clock_origin = origin; }
+
+  void received(record_type type, size_t size) {
+    records[type].store(records[type].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    bytes[type].store(bytes[type].load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+  }
+  void consumed(events::event const& e);
+  void set_dropped(uint64_t count) { dropped.store(count, std::memory_order_relaxed); }
+
+  counters current() const;
+  // JSON object with the rates since the previous counters
+  void write_json(std::ostream& os, counters const& previous, std::chrono::nanoseconds elapsed) const;
+  // Human readable summary of the whole run
+  void write_summary(std::ostream& os, std::chrono::nanoseconds elapsed) const;
+};
+
+/**
+ * Rewrites the statistics file with a snapshot every interval and once more when destroyed,
+ * the file is replaced atomically so that readers never see a partial snapshot.
+ * The summary of the run is written to the standard error when destroyed.
+ */
+class stats_reporter {
+  pipeline_stats const& stats;
+  std::filesystem::path path;
+  std::chrono::milliseconds interval;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  pipeline_stats::counters previous;
+  std::chrono::steady_clock::time_point previous_time = start;
+
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  bool stopping = false;
+  std::thread worker;
+
+  void run();
+  void write_snapshot();
+
+ public:
+  stats_reporter(pipeline_stats const& stats, std::filesystem::path path, std::chrono::milliseconds interval);
+  ~stats_reporter();
+};
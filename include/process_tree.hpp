@@ -0,0 +1,25 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+// State of a running process read from /proc
+struct process_snapshot {
+  pid_t pid;
+  pid_t parent;
+  uid_t uid;
+  // Arguments separated by spaces, as in exec events
+  std::string command;
+  std::string working_directory;
+  // Threads other than the main one
+  std::vector<pid_t> threads;
+};
+
+// The process and all its descendants, parents come before their children.
+// Empty if the process does not exist.
+std::vector<process_snapshot> read_process_tree(pid_t root);
+
+// The process or thread has gone through exit, it may still be a zombie
+bool process_exited(pid_t pid);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <optional>
+
+#include "event_decoder.hpp"
+#include "event_provider.hpp"
+#include "trace_recording.hpp"
+
+// Provides the events of a recording, decoded as they would be during tracing
+class replay_provider : public events::event_provider {
+  trace_recording recording;
+  event_decoder decoder;
+  size_t offset = 0;
+
+ public:
+  replay_provider(trace_recording recording);
+  bool is_active() override;
+  std::optional<events::event> provide() override;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Digest of the output of a program of a run, see output_digest
+struct group_digest {
+  std::string command;
+  std::string working_directory;
+  std::optional<int> exit_code;
+  uint64_t digest = 0;
+};
+
+// A program that does not produce the same output in both runs
+struct changed_group {
+  std::string command;
+  std::string working_directory;
+  // Programs with the command and directory in either run
+  size_t count_a = 0;
+  size_t count_b = 0;
+  // Programs of either run without a program of the same digest in the other run
+  size_t changed = 0;
+  // Exit code of a changed program of either run, if any
+  std::optional<int> exit_code_a;
+  std::optional<int> exit_code_b;
+};
+
+/**
+ * Digests of all programs of a run, saved as the file digests in the html run directory.
+ * The records follow a header, one for every program, each holds
+ * the digest, the exit code and the sizes of the command and directory which follow it.
+ */
+namespace run_digests {
+// Name of the file in the run directory
+extern char const *const FILE_NAME;
+
+void save(std::filesystem::path const& path, std::vector<group_digest> const& digests);
+std::vector<group_digest> load(std::filesystem::path const& path);
+
+/**
+ * Programs are matched by their command and working directory. When a command runs
+ * more than once, e.g. a compiler during a parallel build, the runs are compared as sets
+ * of digests, since the order in which they run can differ.
+ * Every program is looked up in a hash table, the comparison takes time linear
+ * in the number of programs. The result is in the order of the programs of run b.
+ */
+std::vector<changed_group> diff(std::vector<group_digest> const& a, std::vector<group_digest> const& b);
+
+void print(std::ostream& os, std::vector<changed_group> const& changes);
+}  // namespace run_digests
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "events.hpp"
+
+// A run of anteater as recorded in the journal
+struct run_info {
+  // Name of the run directory
+  std::string directory;
+  // Path of the first page relative to the logs directory
+  std::string link;
+  std::string command;
+  events::time_point start;
+  events::time_point end;
+  std::optional<int> exit_code;
+  uintmax_t bytes = 0;
+
+  bool failed() const { return exit_code.value_or(0) != 0; }
+};
+
+struct journal_record {
+  enum class type : uint32_t { START = 1, FINISH = 2 };
+
+  type kind;
+  // Number of the finished run, counted from 0 in the order of FINISH records
+  uint64_t sequence = 0;
+  run_info run;
+};
+
+/**
+ * Append-only binary journal of the runs kept in a logs directory.
+ * A run appends a START record when it begins and a FINISH record when it ends.
+ *
+ * Records have a fixed size, so the journal can be read from the end without parsing
+ * what precedes. Every access opens the journal and holds an exclusive flock,
+ * records are appended with a single write to a descriptor opened with O_APPEND,
+ * which keeps concurrent runs on the same host from interleaving or losing records,
+ * also when the journal is compacted and replaced in the meantime.
+ */
+class run_journal {
+  std::filesystem::path path;
+  int fd;
+
+ public:
+  // Opens and locks the journal, creating it if needed
+  run_journal(std::filesystem::path const& path);
+  ~run_journal();
+  run_journal(run_journal const&) = delete;
+  run_journal& operator=(run_journal const&) = delete;
+
+  // FINISH records get the next sequence number
+  void append(journal_record record);
+  size_t size() const;
+  journal_record read(size_t index) const;
+  // Records from the end backwards until the predicate returns false, newest first
+  template <class F>
+  void read_backwards(F&& f) const {
+    for (size_t i = size(); i > 0; i--)
+      if (!f(read(i - 1))) return;
+  }
+  std::vector<journal_record> read_all() const;
+  // Replaces the contents of the journal, used for compaction
+  void rewrite(std::vector<journal_record> const& records);
+};
+
+// Journal of the runs kept in a logs directory
+std::filesystem::path run_journal_path(std::filesystem::path const& logs_directory);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace events {
+/**
+ * Deduplicates strings that repeat across events, like working directories and user names.
+ * Interned strings are stored in an arena and are never moved or freed,
+ * so views into them stay valid until the end of the program.
+ * Interning a string that is already in the pool does not allocate.
+ */
+class string_pool {
+  std::mutex mutex;
+  std::unordered_set<std::string_view> strings;
+  std::vector<std::unique_ptr<char[]>> chunks;
+  char* current_chunk = nullptr;
+  size_t current_chunk_used = 0;
+
+  char* allocate(size_t size);
+
+ public:
+  std::string_view intern(std::string_view str);
+
+  // The pool used by the events
+  static string_pool& global();
+};
+}  // namespace events
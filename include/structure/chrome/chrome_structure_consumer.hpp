@@ -0,0 +1,55 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+#include "json_writer.hpp"
+#include "structure/structure_consumer.hpp"
+
+class chrome_structure_consumer;
+
+/**
+ * Writes the run in the Chrome trace event format, which can be opened in Perfetto or chrome://tracing.
+ * Every traced process is a separate track, programs are slices on the track of the process
+ * that executed them and writes are instant events.
+ *
+ * The trace is streamed while the events arrive, the root closes the document when destroyed.
+ * Timestamps are relative to the first exec. The trace is gzip compressed if its name ends with .gz.
+ */
+class chrome_structure_consumer_root : public structure_consumer {
+  std::unique_ptr<std::ostream> file;
+  json_writer writer;
+  // Set by the first exec, every consumer refers to it
+  std::optional<events::time_point> origin;
+
+ public:
+  using group = chrome_structure_consumer;
+
+  chrome_structure_consumer_root(std::filesystem::path path);
+  ~chrome_structure_consumer_root();
+  void consume(events::fork_event const&) {}
+  std::unique_ptr<structure_consumer> consume(events::exec_event const&);
+  void consume(events::exit_event const&) {}
+  void consume(events::write_event const&) {}
+};
+
+/**
+ * Consumes events emitted by a single program
+ */
+class chrome_structure_consumer final : public structure_consumer {
+  json_writer& writer;
+  events::time_point const& origin;
+  pid_t my_pid;
+  bool ended = false;
+
+  void end_slice(events::time_point timestamp);
+
+ public:
+  using structure_consumer::consume;
+  chrome_structure_consumer(json_writer& writer, events::time_point const& origin, events::exec_event const& source_event);
+  void consume(events::fork_event const&) {}
+  std::unique_ptr<structure_consumer> consume(events::exec_event const&);
+  void consume(events::exit_event const&);
+  void consume(events::write_event const&);
+};
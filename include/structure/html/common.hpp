@@ -1,5 +1,13 @@
 #pragma once
 
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "events.hpp"
+#include "run_journal.hpp"
+
 struct parent_path_info
 {
   std::string filename;
@@ -11,4 +19,64 @@ struct root_path_info
   std::string root_command;
   std::filesystem::path root_command_path;
   std::filesystem::path index_path;
+  std::filesystem::path timeline_path;
+};
+
+struct html_options
+{
+  // Events of a program are split into pages of this many entries,
+  // so that a page of a noisy program stays small enough for a browser
+  size_t events_per_page = 5000;
+  // Pages are written gzip compressed, the index stays uncompressed
+  bool compress = false;
+
+  std::string extension() const { return compress ? ".html.gz" : ".html"; }
+};
+
+// A page with a chunk of the events of a program
+struct page_info
+{
+  std::string filename;
+  events::time_point first_timestamp;
+  events::time_point last_timestamp;
+  size_t events = 0;
+};
+
+struct child_info
+{
+  pid_t pid;
+  std::string command;
+  std::string filename;
+  std::optional<int> exit_code;
+};
+
+/**
+ * Everything shown on the first page of a program.
+ * The page is rewritten whenever the summary changes substantially,
+ * so it contains no scripts and is always up to date once the program finished.
+ */
+struct program_summary
+{
+  events::exec_event source_event;
+  std::optional<parent_path_info> parent_info;
+  std::optional<int> exit_code;
+  std::optional<events::time_point> last_entry_timestamp;
+  std::vector<page_info> pages;
+  std::vector<child_info> children;
+  events::sched_stats sched;
+  size_t profiled_processes = 0;
+};
+
+// A page of the index of all runs
+struct index_page
+{
+  std::string title;
+  // Link to the main index from older pages
+  std::optional<std::string> index_link;
+  std::vector<run_info> running;
+  std::vector<run_info> failed;
+  std::vector<run_info> runs;
+  // Older pages, newest first
+  std::vector<std::string> pages;
+  std::optional<std::string> legacy_index;
 };
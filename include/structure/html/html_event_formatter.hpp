@@ -5,26 +5,32 @@
 #include <filesystem>
 
 #include "structure/html/common.hpp"
+#include "structure/output_budget.hpp"
+#include "structure/process_timeline.hpp"
 
 struct html_event_formatter {
-    void begin_index(std::ostream& os) const;
-    void format_index_link(
-        std::ostream& os,
-        std::chrono::system_clock::time_point timestamp,
-        std::string const& href, 
-        std::string const& displayed_text
-    ) const;
+    // Complete page of the index of runs
+    void format_index(std::ostream& os, index_page const& page) const;
 
-    void begin(
-        std::ostream& os, 
-        events::exec_event const& source_event, 
-        root_path_info const& root_info,
-        std::optional<parent_path_info> const& parent_info
+    // Complete page with the timeline of a finished run
+    void format_timeline(std::ostream& os, process_timeline const& timeline, root_path_info const& root_info) const;
+
+    // Complete first page of a program, rewritten whenever the summary changes
+    void summary(std::ostream& os, program_summary const& summary, root_path_info const& root_info) const;
+    // Page with a chunk of the events of a program, the events are formatted between begin_page and end_page
+    void begin_page(
+        std::ostream& os,
+        std::string const& summary_filename,
+        std::string_view command,
+        size_t page_number,
+        std::optional<std::string> const& previous
     ) const;
-    void end(std::ostream&) const;
+    void end_page(std::ostream& os, std::string const& summary_filename, std::optional<std::string> const& next) const;
+    // Fills in the exit code of an exec row, must be written to the page containing that row
     void child_exit(std::ostream& os, events::exit_event const& pid) const;
     void format(std::ostream&, events::fork_event const&) const;
     void format(std::ostream&, events::exit_event const&) const;
     void format(std::ostream&, events::exec_event const&, std::filesystem::path) const;
     void format(std::ostream&, events::write_event const&) const;
+    void format(std::ostream&, output_elided const&) const;
 };
\ No newline at end of file
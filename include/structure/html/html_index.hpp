@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+
+#include "run_journal.hpp"
+#include "structure/html/html_event_formatter.hpp"
+
+/**
+ * Index of the html logs, rendered from the run journal.
+ *
+ * Finished runs are split into pages of a fixed size in the order they finished.
+ * A page is written once, when it fills up. index.html shows the running runs,
+ * the recent failures and the runs of the page being filled, and is rewritten on every update.
+ * An update reads only the end of the journal, so it costs the same regardless of the number of runs.
+ */
+class html_index {
+  std::filesystem::path logs_directory;
+  html_event_formatter const& fmt;
+
+  void write_page(std::string const& name, index_page const& page) const;
+  void write_full_page(size_t number, std::vector<run_info> const& runs) const;
+  void write_index(run_journal const& journal, bool seal) const;
+
+ public:
+  static constexpr size_t RUNS_PER_PAGE = 500;
+
+  html_index(std::filesystem::path logs_directory, html_event_formatter const& fmt);
+
+  // Called with the journal locked after a record was appended
+  void update(run_journal const& journal) const;
+  // Rewrites all pages, used after the journal was compacted
+  void rebuild(run_journal const& journal) const;
+
+  // index.html of older versions is kept as it can not be rebuilt from the journal
+  static void keep_legacy_index(std::filesystem::path const& logs_directory);
+};
@@ -2,10 +2,18 @@
 
 #include <filesystem>
 #include <fstream>
+#include <unordered_map>
 
+#include "content_digest.hpp"
+#include "run_digests.hpp"
+#include "run_journal.hpp"
 #include "structure/structure_consumer.hpp"
 #include "structure/html/html_event_formatter.hpp"
 #include "structure/html/common.hpp"
+#include "structure/process_timeline.hpp"
+#include "terminal_lines.hpp"
+
+class html_structure_consumer;
 
 /**
   * Root consumer which does not represent any program
@@ -13,45 +21,84 @@
 */
 class html_structure_consumer_root : public structure_consumer {
   root_path_info root_info;
+  html_options options;
   html_event_formatter fmt;
   std::filesystem::path logs_directory;
+  std::filesystem::path run_directory;
+  process_timeline timeline;
+  std::vector<group_digest> digests;
+  run_info run;
+  pid_t root_pid;
+
+  void record_run(journal_record::type kind);
 
 public:
-  html_structure_consumer_root(std::filesystem::path logs_directory);
+  using group = html_structure_consumer;
+
+  html_structure_consumer_root(std::filesystem::path logs_directory, html_options options = {});
+  // Writes the timeline and the digests and finishes the run in the journal, all programs must be already finished
+  ~html_structure_consumer_root();
   void consume(events::fork_event const&) {}
   std::unique_ptr<structure_consumer> consume(events::exec_event const&);
-  void consume(events::exit_event const&) {}
+  void consume(events::exit_event const&);
   void consume(events::write_event const&) {}
 };
 
 /**
  * Consumes and represents events emitted by a single program
+ *
+ * The program is described by a small summary page, its events are split
+ * into pages of html_options::events_per_page entries linked from the summary.
 */
-class html_structure_consumer : public structure_consumer {
+class html_structure_consumer final : public structure_consumer {
+  struct child_entry {
+    size_t index;
+    // Page containing the exec row of the child
+    size_t page;
+  };
+
   html_event_formatter const& fmt;
+  html_options const& options;
+  // Path of the summary page
   std::filesystem::path filename;
-  std::ofstream file;
+  // The last page, open for appending
+  std::unique_ptr<std::ostream> file;
   pid_t my_pid;
   std::string command;
   root_path_info const& root_info;
+  process_timeline& timeline;
+  process_timeline::node_id node;
+  std::vector<group_digest>& digests;
+  output_digest digest;
+  program_summary summary;
+  std::unordered_map<pid_t, child_entry> children;
+  // Collapses lines redrawn with carriage returns before they are formatted
+  terminal_lines lines;
+
+  std::string page_filename(size_t page_number) const;
+  void write_summary();
+  // Makes sure that the last page can hold the given number of entries, starting a new page if needed
+  void reserve_entries(events::time_point timestamp, size_t entries);
+  size_t current_page() const { return summary.pages.size(); }
+  void write_lines(events::write_event const& e);
 
   public:
   void consume(events::fork_event const&);
   std::unique_ptr<structure_consumer> consume(events::exec_event const&);
   void consume(events::exit_event const&);
   void consume(events::write_event const&);
+  void consume(events::sched_stats const&);
+  void consume(output_elided const&);
   html_structure_consumer(
     html_event_formatter const& fmt,
-    events::exec_event const& source_event, 
-    std::filesystem::path filename, 
-    root_path_info const& root_info
-  );
-  html_structure_consumer(
-    html_event_formatter const& fmt,
+    html_options const& options,
     events::exec_event const& source_event, 
     std::filesystem::path filename, 
     root_path_info const& root_info,
-    parent_path_info const& parent_info
+    process_timeline& timeline,
+    std::vector<group_digest>& digests,
+    std::optional<parent_path_info> parent_info,
+    std::optional<process_timeline::node_id> parent_node
   );
   ~html_structure_consumer();
 };
\ No newline at end of file
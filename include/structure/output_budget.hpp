@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+
+#include "events.hpp"
+
+// Output of a group left out between the head and the tail of its budget
+struct output_elided {
+  // Timestamp of the first elided write
+  events::time_point timestamp;
+  size_t bytes;
+};
+
+/**
+ * Byte budget of the output of a single group.
+ * The first head bytes are passed on as they come, after that only the last tail bytes
+ * are retained in a rolling buffer and the bytes in between are counted as elided,
+ * so the discarded output is never formatted.
+ */
+class output_budget {
+ public:
+  struct limits {
+    size_t head;
+    size_t tail;
+  };
+
+  struct retained {
+    output_elided elided;
+    std::deque<events::write_event> tail;
+  };
+
+  output_budget(limits l);
+
+  // Number of leading bytes of the write which fit in the head, the rest goes to the tail
+  size_t admit(events::write_event const& e);
+  // Takes the tail gathered since the head was exhausted or since the last call
+  std::optional<retained> take();
+
+ private:
+  limits l;
+  size_t head_used = 0;
+  size_t tail_size = 0;
+  std::optional<output_elided> elided;
+  std::deque<events::write_event> tail;
+};
@@ -2,11 +2,33 @@
 
 #include "events.hpp"
 #include <iostream>
+#include <string>
 
-struct plain_event_formatter
+/**
+ * Formats events as text lines.
+ * Lines are gathered in a reusable buffer and written to the stream in large blocks,
+ * flush() has to be called to write out the rest.
+ */
+class plain_event_formatter
 {
+    std::string buffer;
+    // Timestamps change their second rarely compared to the event rate
+    int64_t cached_second = -1;
+    char cached_prefix[19];
+
+    void append_header(events::event_base const&, std::string_view name);
+    void append_timestamp(events::time_point timestamp);
+    void append_number(int64_t number);
+    void append_padded(std::string_view str, size_t width);
+    void append_unescaped(std::string_view str);
+    void maybe_flush(std::ostream&);
+
+public:
     void format(std::ostream&, events::fork_event const&);
     void format(std::ostream&, events::exit_event const&);
     void format(std::ostream&, events::exec_event const&);
     void format(std::ostream&, events::write_event const&);
-};
\ No newline at end of file
+    void flush(std::ostream&);
+    // Flushes and frees the buffer, which grows again with the next event
+    void release(std::ostream&);
+};
@@ -5,24 +5,36 @@
 
 #include "structure/structure_consumer.hpp"
 #include "plain_event_formatter.hpp"
+#include "terminal_lines.hpp"
 
 class plain_structure_consumer : public structure_consumer {
-  class subconsumer : public structure_consumer {
+  class subconsumer final : public structure_consumer {
     std::filesystem::path filename;
-    std::ofstream file;
+    bool compress;
+    std::unique_ptr<std::ostream> file;
+    pid_t my_pid;
     plain_event_formatter fmt;
+    terminal_lines lines;
+
+    std::ostream& output();
 
    public:
+    using structure_consumer::consume;
     void consume(events::fork_event const&);
     std::unique_ptr<structure_consumer> consume(events::exec_event const&);
     void consume(events::exit_event const&);
     void consume(events::write_event const&);
-    subconsumer(std::filesystem::path filename);
+    subconsumer(std::filesystem::path filename, bool compress, pid_t pid);
+    ~subconsumer();
   };
 
  std::filesystem::path logs_directory;
+ bool compress;
  public:
-  plain_structure_consumer(std::filesystem::path logs_directory);
+  using group = subconsumer;
+
+  // Logs are written gzip compressed (.txt.gz) if requested
+  plain_structure_consumer(std::filesystem::path logs_directory, bool compress = false);
   void consume(events::fork_event const&) {}
   std::unique_ptr<structure_consumer> consume(events::exec_event const&);
   void consume(events::exit_event const&) {}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "events.hpp"
+
+/**
+ * Lifetimes of all programs (exec groups) of a single run, laid out in lanes
+ * so that programs running concurrently never share a lane.
+ *
+ * The timeline also finds the critical path: the chain of dependent programs
+ * that determined the wall time of the run. A program depends on its children,
+ * and a child depends on the sibling which finished last before it started.
+ * Starting from the top-level program, the critical path follows the child that
+ * finished last and then the chain of its predecessors.
+ *
+ * Programs must be started and ended in the order of their timestamps,
+ * every update is O(1) and the critical path is found in O(n).
+ */
+class process_timeline {
+ public:
+  using node_id = size_t;
+
+  struct node {
+    std::string command;
+    std::string link;
+    events::time_point start;
+    events::time_point end;
+    bool ended = false;
+    bool critical = false;
+    size_t lane;
+    std::optional<node_id> parent;
+    // The sibling which finished last before this program started
+    std::optional<node_id> predecessor;
+    std::optional<node_id> last_finished_child;
+  };
+
+  node_id begin(std::optional<node_id> parent, events::time_point start, std::string command, std::string link);
+  // Ending a program more than once has no effect
+  void end(node_id id, events::time_point timestamp);
+  // Ends all programs that are still running at the latest known timestamp and marks the critical path
+  void finish();
+
+  std::vector<node> const& nodes() const { return all_nodes; }
+  // Programs on the critical path ordered by start, valid after finish()
+  std::vector<node_id> critical_path() const;
+  size_t lanes() const { return lane_count; }
+  events::time_point first_timestamp() const { return first; }
+  events::time_point last_timestamp() const { return last; }
+
+ private:
+  std::vector<node> all_nodes;
+  std::vector<size_t> free_lanes;
+  size_t lane_count = 0;
+  // Plays the role of last_finished_child of the (virtual) parent of top-level programs
+  std::optional<node_id> last_finished_root;
+  events::time_point first = events::time_point::max();
+  events::time_point last = events::time_point::min();
+
+  std::optional<node_id>& last_finished_child(std::optional<node_id> parent);
+  void update_bounds(events::time_point timestamp);
+};
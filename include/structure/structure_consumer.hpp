@@ -1,13 +1,21 @@
 #pragma once
 
 #include "events.hpp"
+#include "structure/output_budget.hpp"
 
 class structure_consumer {
  public:
+  // Type of the consumers created for executed programs, see basic_structure_provider
+  using group = structure_consumer;
+
   virtual void consume(events::fork_event const&) = 0;
   // Consume exec event and create new consumer for the executed program
   virtual std::unique_ptr<structure_consumer> consume(events::exec_event const&) = 0;
   virtual void consume(events::exit_event const&) = 0;
   virtual void consume(events::write_event const&) = 0;
+  // Consume scheduler statistics of a process that exited while belonging to this group
+  virtual void consume(events::sched_stats const&) {}
+  // Consume the size of the output left out by the output budget, the retained tail follows
+  virtual void consume(output_elided const&) {}
   virtual ~structure_consumer() = default;
 };
\ No newline at end of file
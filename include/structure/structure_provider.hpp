@@ -2,47 +2,207 @@
 
 #include <map>
 #include <memory>
+#include <optional>
+#include <stack>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 #include "event_consumer.hpp"
 #include "structure_consumer.hpp"
+#include "structure/output_budget.hpp"
+
+struct structure_provider_options {
+  // Limits the output of every group to its head and tail, unlimited if empty
+  std::optional<output_budget::limits> output_limits;
+};
 
 /**
  * Consumes events and organizes them into a tree-like debug structure.
  * Each process is assigned to a group that gathers its events.
  * Every EXEC (not FORK) event creates a separate group for the process and all
  * its descendants in the same group.
- * 
+ *
  * When a process exits, the EXIT event is logged in every group that this process has created.
+ *
+ * With an output budget, the retained tail of a group is passed on when the process
+ * that created the group exits or execs again, and when the provider is destroyed.
+ *
+ * Root is the type of the root consumer and Root::group the type of the consumers
+ * created by the root and by the groups themselves. With a concrete final group type
+ * the calls for every event are resolved at compile time, with structure_consumer
+ * as the root they go through the virtual functions, which any consumer can implement.
  */
-class structure_provider : public events::event_consumer {
-  std::unique_ptr<structure_consumer> root;
+template <class Root>
+class basic_structure_provider : public events::event_consumer {
+  using group = typename Root::group;
+  static_assert(std::is_base_of_v<structure_consumer, group>, "The groups of Root must be structure consumers");
+  static_assert(
+    std::is_convertible_v<decltype(std::declval<Root&>().consume(std::declval<events::exec_event const&>())),
+                          std::unique_ptr<structure_consumer>>,
+    "Root must create the consumer of an executed program"
+  );
+
+  std::unique_ptr<Root> root;
   std::vector<std::unique_ptr<structure_consumer>> structure_consumers;
-  
-  // The current group that process is logging to
-  std::map<pid_t, structure_consumer*> pid_to_group;
+
+  // The current group that process is logging to, null before the first exec
+  std::map<pid_t, group*> pid_to_group;
 
   // Children created by forks
   std::map<pid_t, std::vector<pid_t>> pid_to_children;
 
-  // For each process, the groups that contain the exec of it
-  std::map<pid_t, std::vector<structure_consumer*>> pid_to_exec_groups;  
+  // For each process, the groups that contain the exec of it, null for the root
+  std::map<pid_t, std::vector<group*>> pid_to_exec_groups;
+
+  struct group_budget {
+    pid_t owner;
+    output_budget budget;
+  };
+
+  structure_provider_options options;
+  std::unordered_map<group*, group_budget> budgets;
 
   struct event_visitor {
-    structure_provider& provider;
-    event_visitor(structure_provider& provider);
+    basic_structure_provider& provider;
+
+    void operator()(const events::fork_event& e) {
+      // Fork creates a new process which belongs to the same group as the parent
+      provider.pid_to_children[e.source_pid].push_back(e.child_pid);
+      provider.pid_to_group[e.child_pid] = provider.pid_to_group[e.source_pid];
+    }
+
+    void operator()(const events::exec_event& e) {
+      // Exec creates a new "program" which belongs to a separate group
+
+      // Processes that we didn't create a group for belong to the root
+      group* parent = provider.pid_to_group[e.source_pid];
+      std::unique_ptr<structure_consumer> new_consumer;
+      if (parent == nullptr) {
+        new_consumer = provider.root->consume(e);
+      } else {
+        // The program that owned the group is replaced
+        provider.release_tail(parent, e.source_pid);
+        new_consumer = parent->consume(e);
+      }
+
+      auto new_group = as_group(new_consumer.get());
+      provider.pid_to_exec_groups[e.source_pid].push_back(parent);
+      provider.set_subtree_group(e.source_pid, new_group);
+      if (provider.options.output_limits.has_value())
+        provider.budgets.emplace(new_group, group_budget{e.source_pid, provider.options.output_limits.value()});
+      provider.structure_consumers.push_back(std::move(new_consumer));
+    }
+
+    void operator()(const events::exit_event& e) {
+      // Processes which did not exec and were not forked by a traced process have no group
+      if (group* g = provider.pid_to_group[e.source_pid]) {
+        provider.release_tail(g, e.source_pid);
+        g->consume(e);
+        if (e.sched.has_value())
+          g->consume(e.sched.value());
+      }
+      for (auto exec_group : provider.pid_to_exec_groups[e.source_pid]) {
+        if (exec_group == nullptr)
+          provider.root->consume(e);
+        else
+          exec_group->consume(e);
+      }
+    }
 
-    void operator()(const events::fork_event& e);
-    void operator()(const events::exec_event& e);
-    void operator()(const events::exit_event& e);
-    void operator()(const events::write_event& e);
+    void operator()(const events::write_event& e) {
+      group* g = provider.pid_to_group[e.source_pid];
+      if (g == nullptr)
+        return;
+      if (provider.budgets.empty()) {
+        g->consume(e);
+        return;
+      }
+      auto budget = provider.budgets.find(g);
+      if (budget == provider.budgets.end()) {
+        g->consume(e);
+        return;
+      }
+
+      size_t admitted = budget->second.budget.admit(e);
+      if (admitted == e.data.size()) {
+        g->consume(e);
+      } else if (admitted > 0) {
+        events::write_event head{e};
+        head.data.resize(admitted);
+        g->consume(head);
+      }
+    }
   };
 
-  event_visitor visitor;
+  event_visitor visitor{*this};
+
+  // The consumer of a program is checked once, so that the calls for its events need no check
+  static group* as_group(structure_consumer* consumer) {
+    group* result;
+    if constexpr (std::is_same_v<group, structure_consumer>)
+      result = consumer;
+    else
+      result = dynamic_cast<group*>(consumer);
+    if (result == nullptr)
+      throw std::runtime_error{"The consumer of an executed program is not a group of the structure"};
+    return result;
+  }
+
+  void set_subtree_group(pid_t root, group* g) {
+    // When process execs (i.e. creates a new program) all its children change the group
+
+    // Traverse the process tree using DFS
+    std::stack<pid_t> pids;
+    pids.push(root);
+
+    while (!pids.empty()) {
+      pid_t current = pids.top();
+      pids.pop();
+      for (pid_t child : pid_to_children[current])
+        if (pid_to_group[child] == pid_to_group[current]) pids.push(child);
+      pid_to_group[current] = g;
+    }
+  }
 
-  void set_subtree_group(pid_t root, structure_consumer* group);
+  // Passes on the retained tail of the group if the process is its owner
+  void release_tail(group* g, std::optional<pid_t> owner = {}) {
+    auto budget = budgets.find(g);
+    if (budget == budgets.end())
+      return;
+    if (owner.has_value() && budget->second.owner != owner.value())
+      return;
+
+    auto retained = budget->second.budget.take();
+    if (!retained.has_value())
+      return;
+    if (retained->elided.bytes > 0)
+      g->consume(retained->elided);
+    for (auto const& e : retained->tail)
+      g->consume(e);
+  }
 
  public:
-  structure_provider(std::unique_ptr<structure_consumer> root);
-  void consume(events::event const& e);
-};
\ No newline at end of file
+  basic_structure_provider(std::unique_ptr<Root> root, structure_provider_options options = {})
+      : root(std::move(root)), options(options) {}
+
+  ~basic_structure_provider() {
+    for (auto& [g, budget] : budgets)
+      release_tail(g);
+  }
+
+  void consume(events::event const& e) { std::visit(visitor, e); }
+
+  // Output of the process which did not reach the provider, e.g. dropped by fan_out
+  void consume(pid_t pid, output_elided const& e) {
+    group* g = pid_to_group[pid];
+    if (g != nullptr)
+      g->consume(e);
+  }
+};
+
+// Dispatches through the virtual functions of structure_consumer
+using structure_provider = basic_structure_provider<structure_consumer>;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "events.hpp"
+#include "trace_recording.hpp"
+
+/**
+ * Builds recordings of made-up workloads in the format of the BPF programs,
+ * so that the user space pipeline can be measured without root and a kernel.
+ * Every record is one microsecond after the previous one.
+ */
+class synthetic_trace {
+  trace_recording recording;
+  uint64_t clock = 0;
+  // keys of the working directories, the path is sent only with the first exec in each as the BPF programs do
+  std::map<std::string, uint64_t, std::less<>> directories;
+
+  uint64_t tick();
+
+ public:
+  synthetic_trace();
+  synthetic_trace& fork(pid_t parent, pid_t child);
+  synthetic_trace& exec(pid_t pid, std::string_view command, std::string_view working_directory = "/home/user");
+  synthetic_trace& write(pid_t pid, events::write_event::descriptor fd, std::string_view data);
+  synthetic_trace& exit(pid_t pid, int code = 0);
+  trace_recording const& result() const { return recording; }
+};
+
+namespace workloads {
+// Root process forking processes which write a line and exit
+trace_recording fork_storm(size_t processes);
+// Every process forks and executes the next one, the deepest one writes a line
+trace_recording exec_chain(size_t depth);
+
+struct write_flood_options {
+  size_t processes = 1;
+  size_t writes = 10000;
+  size_t line_length = 80;
+  // Fraction of writes which color the line and redraw it with a carriage return, as progress bars do
+  double ansi_density = 0;
+};
+// Processes writing lines in turns
+trace_recording write_flood(write_flood_options const& options);
+}  // namespace workloads
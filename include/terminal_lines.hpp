@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "events.hpp"
+
+/**
+ * Simple terminal line model of the output of every (process, descriptor) pair.
+ * A carriage return moves back to the beginning of the line which is then overwritten,
+ * so a progress bar redrawn hundreds of times ends up as the single line a human saw.
+ *
+ * Complete lines are emitted as write events. Writes that consist of complete lines
+ * and do not touch an unfinished line are emitted unchanged. An unfinished line is emitted
+ * when it has been pending for longer than the window at the time of the next write
+ * of its process, or when it is flushed.
+ *
+ * Escape sequences are kept as they are, except on lines containing a carriage return,
+ * where they are dropped apart from erasing the rest of the line.
+ */
+class terminal_lines {
+ public:
+  using emit_function = std::function<void(events::write_event const&)>;
+
+  terminal_lines(emit_function emit, std::chrono::nanoseconds window = std::chrono::seconds{1});
+
+  void write(events::write_event const& e);
+  // Emits the unfinished lines of the process, e.g. when it exits
+  void flush(pid_t pid);
+  void flush_all();
+
+ private:
+  struct line {
+    std::string text;
+    size_t cursor = 0;
+    // Set after a carriage return, the line is overwritten from then on
+    bool overwriting = false;
+    events::time_point start;
+  };
+
+  struct stream {
+    line current;
+    bool pending = false;
+  };
+
+  emit_function emit;
+  std::chrono::nanoseconds window;
+  std::unordered_map<uint64_t, stream> streams;
+  // Reused for the emitted text
+  events::write_event output;
+
+  void put(line& l, std::string_view data, size_t& i);
+  void begin_output(events::write_event const& e, events::time_point timestamp);
+  void end_line(stream& s);
+  void flush_output();
+  void flush(pid_t pid, events::write_event::descriptor fd);
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <vector>
+
+#include "events.hpp"
+
+/**
+ * Raw records of the BPF programs, saved so that they can be replayed without root.
+ *
+ * The file starts with a header holding the boot time the record timestamps
+ * are relative to, the records follow, each preceded by its size and padded
+ * to 8 bytes so that it can be read in place.
+ */
+class trace_recording {
+  events::time_point boot_time;
+  std::vector<char> data;
+
+ public:
+  trace_recording(events::time_point boot_time);
+  static trace_recording load(std::filesystem::path const& path);
+  void save(std::filesystem::path const& path) const;
+
+  // Writes the parts of the format to a stream as the records arrive
+  static void write_header(std::ostream& os, events::time_point boot_time);
+  static void write_record(std::ostream& os, void const *record, size_t size);
+
+  void append(void const *record, size_t size);
+  events::time_point boot() const { return boot_time; }
+  // Size of the records in bytes
+  size_t size() const { return data.size(); }
+
+  // Record at the offset, which is moved to the next one
+  void const *next(size_t& offset, size_t& size) const;
+};
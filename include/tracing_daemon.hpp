@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <unordered_map>
+
+#include "bpf_programs.hpp"
+#include "bpf_provider.hpp"
+#include "daemon_protocol.hpp"
+
+/**
+ * Keeps the BPF programs loaded between runs, so that a run does not pay for loading,
+ * verifying and attaching them. Every client connecting to the unix socket gets its own session:
+ * the daemon sends it the session id and forwards to it the ring buffer records of that session
+ * until it disconnects, after which the processes of the session stop being traced.
+ *
+ * The processes map is pinned in bpffs, the client registers its command in it directly
+ * before the command is executed, as a local run does.
+ *
+ * Records are sent without blocking, so that a client which stops reading does not hold up
+ * the ring buffer of the others. Records it cannot take yet wait in its backlog, a client whose
+ * backlog exceeds MAX_BACKLOG is disconnected, which ends its session.
+ */
+class tracing_daemon {
+  bpf_programs programs;
+  std::filesystem::path socket_path;
+  int listener;
+  static constexpr size_t MAX_BACKLOG = 16 << 20;
+
+  struct client {
+    int fd;
+    // Records not yet accepted by the socket
+    std::deque<std::string> backlog;
+    size_t backlog_bytes = 0;
+  };
+
+  uint32_t next_session = 1;
+  // Connected clients by their session
+  std::unordered_map<uint32_t, client> clients;
+  std::atomic<bool> stopping = false;
+
+  static int forward(void *ctx, void *data, size_t len);
+  void accept_client();
+  // Sends the backlog of the client, false if the client is gone
+  bool send_backlog(client& c);
+  void end_session(uint32_t session);
+
+ public:
+  tracing_daemon(bpf_provider_options const& options, std::filesystem::path socket_path = daemon_protocol::DEFAULT_SOCKET);
+  ~tracing_daemon();
+  // Serves clients until stop is called, then reports the statistics of the programs if they were collected
+  void run();
+  // Can be called from a signal handler
+  void stop() { stopping = true; }
+};
@@ -16,32 +16,88 @@ enum descriptor {
     STDERR
 };
 
+/**
+ * Programs which count their invocations by untraced tasks when statistics are collected,
+ * indices of the untraced_invocations map.
+*/
+enum traced_program {
+    PROGRAM_EXEC,
+    PROGRAM_FORK,
+    PROGRAM_EXIT,
+    PROGRAM_WRITE_ENTER,
+    PROGRAM_WRITE_EXIT,
+    TRACED_PROGRAMS
+};
+
+/**
+ * Every event starts with its type and the session of the traced process.
+ * A session is one traced command with all its descendants, the value of the process in the processes map.
+*/
+struct event_header {
+    enum event_type type;
+    unsigned int session;
+};
+
 struct fork_event {
     enum event_type type;
+    unsigned int session;
     unsigned long long timestamp;
     pid_t parent;
     pid_t child;
 };
 
+/**
+ * Identity of a working directory. The path of a directory is sent only with the first exec
+ * in it within a session, later execs refer to it by this key.
+ * The key includes the number of moved directories on the system, so that a moved directory gets sent again.
+*/
+struct working_directory_key {
+    unsigned long long dentry;
+    unsigned long long mount;
+    unsigned long long inode;
+    unsigned long long renames;
+};
+
 struct exec_event {
     enum event_type type;
+    unsigned int session;
     unsigned long long timestamp;
     pid_t proc;
     uid_t uid;
     int args_size;
     int working_directory_size;
+    // The path is not in data, it was sent with an earlier exec
+    int working_directory_cached;
+    struct working_directory_key working_directory_key;
     char data[];
 };
 
+#define RUNQUEUE_HISTOGRAM_BUCKETS 20
+
+/**
+ * Scheduler accounting of a single process, filled only when scheduler profiling is enabled.
+ * Bucket i of the histogram counts runqueue waits in [2^i, 2^(i+1)) microseconds.
+*/
+struct scheduling_stats {
+    unsigned long long on_cpu_ns;
+    unsigned long long off_cpu_ns;
+    unsigned long long runqueue_ns;
+    unsigned int runqueue_histogram[RUNQUEUE_HISTOGRAM_BUCKETS];
+};
+
 struct exit_event {
     enum event_type type;
+    unsigned int session;
     unsigned long long timestamp;
     pid_t proc;
     int code;
+    int has_scheduling_stats;
+    struct scheduling_stats scheduling;
 };
 
 struct write_event {
     enum event_type type;
+    unsigned int session;
     unsigned long long timestamp;
     enum descriptor fd;
     pid_t proc;
@@ -53,9 +109,10 @@ union event {
     /**
      * Type is common between all event types and we add it here for memory savings.
      * The behavior of such pattern is implementation specific, but we trust that our compiler does it the right way.
-     * Remember that for it to work all event structs need to have event_type as the first field.
+     * Remember that for it to work all event structs need to start with the fields of event_header.
     */
     enum event_type type;
+    struct event_header header;
 
     struct fork_event fork;
     struct exec_event exec;
@@ -69,22 +126,26 @@ union event {
 
 #ifndef __cplusplus
 
-static inline void make_fork_event(struct fork_event *event, pid_t parent, pid_t child) {
+static inline void make_fork_event(struct fork_event *event, unsigned int session, pid_t parent, pid_t child) {
     event->type = FORK;
+    event->session = session;
     event->timestamp = bpf_ktime_get_ns();
     event->parent = parent;
     event->child = child;
 }
 
-static inline void make_exit_event(struct exit_event *event, pid_t proc, int code) {
+static inline void make_exit_event(struct exit_event *event, unsigned int session, pid_t proc, int code) {
     event->type = EXIT;
+    event->session = session;
     event->timestamp = bpf_ktime_get_ns();
     event->proc = proc;
     event->code = code;
+    event->has_scheduling_stats = 0;
 }
 
-static inline void make_exec_event(struct exec_event *event, pid_t proc, int uid, int args_size, int working_directory_size) {
+static inline void make_exec_event(struct exec_event *event, unsigned int session, pid_t proc, int uid, int args_size, int working_directory_size) {
     event->type = EXEC;
+    event->session = session;
     event->timestamp = bpf_ktime_get_ns();
     event->proc = proc;
     event->uid = uid;
@@ -92,8 +153,9 @@ static inline void make_exec_event(struct exec_event *event, pid_t proc, int uid
     event->working_directory_size = working_directory_size;
 }
 
-static inline void make_write_event(struct write_event *event, pid_t proc, enum descriptor fd, int size) {
+static inline void make_write_event(struct write_event *event, unsigned int session, pid_t proc, enum descriptor fd, int size) {
     event->type = WRITE;
+    event->session = session;
     event->timestamp = bpf_ktime_get_ns();
     event->fd = fd;
     event->proc = proc;
@@ -3,6 +3,7 @@
 
 #include <bpf/bpf_core_read.h>
 #include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
 
 #include "event.h"
 
@@ -13,24 +14,61 @@ struct {
   __uint(max_entries, 32 * 1024 * 1024);
 } queue __weak SEC(".maps");
 
+// Records which did not fit into the ring buffer, read by user space
+u64 dropped_events = 0;
+
+static inline long output_event(void *data, u64 size) {
+  long result = bpf_ringbuf_output(&queue, data, size, 0);
+  if (result)
+    __sync_fetch_and_add(&dropped_events, 1);
+  return result;
+}
+
+static inline void *reserve_event(u64 size) {
+  void *result = bpf_ringbuf_reserve(&queue, size, 0);
+  if (result == NULL)
+    __sync_fetch_and_add(&dropped_events, 1);
+  return result;
+}
+
+// Traced processes with their session, children inherit the session of their parent
 struct {
   __uint(type, BPF_MAP_TYPE_HASH);
   __type(key, pid_t);
-  __type(value, int);
+  __type(value, u32);
   __uint(max_entries, 256 * 1024);
 } processes __weak SEC(".maps");
 
+struct session_descriptors {
+  struct file *stdout;
+  struct file *stderr;
+};
+
+// Standard output and error of every session, captured on its first exec
 struct {
-  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(type, BPF_MAP_TYPE_HASH);
   __type(key, u32);
-  __type(value, struct file *);
-  __uint(max_entries, 2);
+  __type(value, struct session_descriptors);
+  __uint(max_entries, 1024);
 } tracked_descriptors __weak SEC(".maps");
 
+// Process whose descriptors are resolved by resolve_descriptors, written by user space before it runs
+struct attach_request {
+  pid_t pid;
+  u32 session;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __type(key, u32);
+  __type(value, struct attach_request);
+  __uint(max_entries, 1);
+} attach_request __weak SEC(".maps");
+
 struct write_data {
   const char *buf;
   enum descriptor fd;
-  int padding;
+  u32 session;
 };
 
 struct {
@@ -48,6 +86,8 @@ struct {
 } aux_maps __weak SEC(".maps");
 
 #define MAX_PATH_COMPONENTS 20
+// Mount points crossed on the way to the root
+#define MAX_PATH_MOUNTS 8
 struct {
   __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
   __type(key, u32);
@@ -55,29 +95,136 @@ struct {
   __uint(max_entries, 1);
 } path_storage __weak SEC(".maps");
 
-inline bool is_process_traced() {
+// Set by user space before the programs are loaded.
+const volatile bool profile_scheduling = false;
+const volatile bool stage_writes = false;
+const volatile u64 stage_flush_ns = 10 * 1000 * 1000;
+const volatile bool collect_stats = false;
+
+// Invocations of the programs by tasks which are not traced, counted when collect_stats is set
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __type(key, u32);
+  __type(value, u64);
+  __uint(max_entries, TRACED_PROGRAMS);
+} untraced_invocations __weak SEC(".maps");
+
+// Staged writes are flushed once they reach this size
+#define WRITE_STAGE_SIZE 2048
+
+/**
+ * Small writes of the task running on a cpu are appended to a staging write event
+ * which is sent as a single record. The staged writes are flushed when the buffer fills,
+ * when the task writes to the other descriptor, forks, execs, exits or is switched out,
+ * and once they are older than stage_flush_ns, before the next write or on a tick of the cpu.
+ * The staged event is empty when its size is 0.
+ */
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __type(key, u32);
+  __type(value, char[sizeof(struct write_event) + 2 * WRITE_STAGE_SIZE]);
+  __uint(max_entries, 1);
+} staged_writes __weak SEC(".maps");
+
+struct working_directory_cache_key {
+  struct working_directory_key directory;
+  u32 session;
+  u32 padding;
+};
+
+// Moves of directories on the system, a move of a directory or any of its ancestors
+// changes its path, so a path is cached only until the next move of a directory.
+// They are counted for every task, a directory can be moved by a task which is not traced.
+u64 renames = 0;
+
+// Working directories whose path was already sent to the session
+struct {
+  __uint(type, BPF_MAP_TYPE_LRU_HASH);
+  __type(key, struct working_directory_cache_key);
+  __type(value, u8);
+  __uint(max_entries, 16 * 1024);
+} cwd_cache __weak SEC(".maps");
+
+struct scheduling_data {
+  struct scheduling_stats stats;
+  u64 switched_in;
+  u64 switched_out;
+  u64 enqueued;
+};
+
+// Shrunk by user space when scheduler profiling is disabled.
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __type(key, pid_t);
+  __type(value, struct scheduling_data);
+  __uint(max_entries, 256 * 1024);
+} scheduling __weak SEC(".maps");
+
+// Session of the current process, NULL when it is not traced
+static inline u32 *current_session(enum traced_program program) {
   pid_t pid = bpf_get_current_pid_tgid();
-  return bpf_map_lookup_elem(&processes, &pid) != NULL;
+  u32 *session = bpf_map_lookup_elem(&processes, &pid);
+  if (session == NULL && collect_stats) {
+    u32 key = program;
+    u64 *count = bpf_map_lookup_elem(&untraced_invocations, &key);
+    if (count != NULL) (*count)++;
+  }
+  return session;
+}
+
+static inline void flush_staged_write(struct write_event *staged) {
+  u32 size = staged->size;
+  if (size == 0 || size > 2 * WRITE_STAGE_SIZE) return;
+  output_event(staged, size + offsetof(struct write_event, data));
+  staged->size = 0;
 }
 
+// Keeps the order of events, writes staged by a process come before its other events
+static inline void flush_staged_writes_of(pid_t pid) {
+  if (!stage_writes) return;
+  u32 key = 0;
+  struct write_event *staged = bpf_map_lookup_elem(&staged_writes, &key);
+  if (staged != NULL && staged->size > 0 && staged->proc == pid)
+    flush_staged_write(staged);
+}
+
+static inline struct mount *real_mount(struct vfsmount *mnt) {
+  return (void *) mnt - bpf_core_field_offset(struct mount, mnt);
+}
 
 // DO NOT TOUCH. IT CAN AND WILL HURT YOU.
-// may not work with paths through multiple mountpoints.
+// Mount points are crossed through the dentry the mount is mounted on.
 static inline long path_to_str(struct path *path, char *buf, int size) {
   struct dentry *dentry = BPF_CORE_READ(path, dentry);
+  struct vfsmount *vfsmnt = BPF_CORE_READ(path, mnt);
+  struct mount *mnt = real_mount(vfsmnt);
   u32 key = 0;
   struct qstr *storage = bpf_map_lookup_elem(&path_storage, &key);
   if(storage == NULL) return -1;
   long path_len = 0;
   long component = 0;
-  for(; component < MAX_PATH_COMPONENTS; component++) {
+  bool reached_root = false;
+  for(int i = 0; i < MAX_PATH_COMPONENTS + MAX_PATH_MOUNTS; i++) {
     struct dentry *parent = BPF_CORE_READ(dentry, d_parent);
-    if(dentry == parent) break;
+    if(dentry == BPF_CORE_READ(vfsmnt, mnt_root) || dentry == parent) {
+      struct mount *mnt_parent = BPF_CORE_READ(mnt, mnt_parent);
+      // the root mount is its own parent
+      if(mnt_parent == mnt) {
+        reached_root = true;
+        break;
+      }
+      dentry = BPF_CORE_READ(mnt, mnt_mountpoint);
+      mnt = mnt_parent;
+      vfsmnt = &mnt->mnt;
+      continue;
+    }
+    if(component >= MAX_PATH_COMPONENTS) return -1;
     storage[component] = BPF_CORE_READ(dentry, d_name);
     path_len += storage[component].len + 1;
+    component++;
     dentry = parent;
   }
-  if(component >= MAX_PATH_COMPONENTS) return -1;
+  if(!reached_root) return -1;
   component--;
   if(path_len > size) return -1;
   char *cur = buf;
@@ -95,29 +242,26 @@ static inline long path_to_str(struct path *path, char *buf, int size) {
 
 SEC("tp/sched/sched_process_exec")
 int handle_exec(struct trace_event_raw_sched_process_exec *ctx) {
-  if (!is_process_traced()) return 0;
+  u32 *traced = current_session(PROGRAM_EXEC);
+  if (traced == NULL) return 0;
+  u32 session = *traced;
 
   pid_t pid = bpf_get_current_pid_tgid();
   uid_t uid = bpf_get_current_uid_gid();
+  flush_staged_writes_of(pid);
 
   struct task_struct *task = (void *) bpf_get_current_task();
 
-  // on first exec save file descriptors
-  u32 stdout_id = 0;
-  u32 stderr_id = 1;
-  struct file **current_stdout = bpf_map_lookup_elem(&tracked_descriptors, &stdout_id);
-  if(current_stdout == NULL)
-    return 0;
-  if(*current_stdout == NULL) {
+  // on first exec of the session save file descriptors
+  if(bpf_map_lookup_elem(&tracked_descriptors, &session) == NULL) {
     struct file **fdt = BPF_CORE_READ(task, files, fdt, fd);
-    struct file *stdout, *stderr;
-    if(bpf_probe_read_kernel(&stdout, sizeof(stdout), fdt + 1))
+    struct session_descriptors descriptors;
+    if(bpf_probe_read_kernel(&descriptors.stdout, sizeof(descriptors.stdout), fdt + 1))
       return 0;
-    if(bpf_probe_read_kernel(&stderr, sizeof(stderr), fdt + 2))
+    if(bpf_probe_read_kernel(&descriptors.stderr, sizeof(descriptors.stderr), fdt + 2))
       return 0;
 
-    bpf_map_update_elem(&tracked_descriptors, &stdout_id, &stdout, BPF_ANY);
-    bpf_map_update_elem(&tracked_descriptors, &stderr_id, &stderr, BPF_ANY);
+    bpf_map_update_elem(&tracked_descriptors, &session, &descriptors, BPF_NOEXIST);
   }
 
   // reserve space for event
@@ -133,53 +277,205 @@ int handle_exec(struct trace_event_raw_sched_process_exec *ctx) {
   if (args_size > 1024) args_size = 1024;
   if (bpf_probe_read_user(e->data, args_size, (void *) args_start)) return 0;
 
-  // find working_directory
+  // find working_directory, its path is sent only once per session
   struct path working_directory = BPF_CORE_READ(task, fs, pwd);
-  int working_directory_size = path_to_str(&working_directory, e->data + args_size, 1024);
-  if(working_directory_size < 0) return 0;
-  if(working_directory_size > 1024) return 0;
+  struct working_directory_cache_key cwd = {
+    .directory = {
+      .dentry = (u64) working_directory.dentry,
+      .mount = (u64) working_directory.mnt,
+      .inode = BPF_CORE_READ(working_directory.dentry, d_inode, i_ino),
+      .renames = renames,
+    },
+    .session = session,
+  };
+  bool cached = bpf_map_lookup_elem(&cwd_cache, &cwd) != NULL;
+  int working_directory_size = 0;
+  if(!cached) {
+    working_directory_size = path_to_str(&working_directory, e->data + args_size, 1024);
+    if(working_directory_size < 0) return 0;
+    if(working_directory_size > 1024) return 0;
+  }
 
-  make_exec_event(e, pid, uid, args_size, working_directory_size);
+  make_exec_event(e, session, pid, uid, args_size, working_directory_size);
+  e->working_directory_cached = cached;
+  e->working_directory_key = cwd.directory;
   int data_size = working_directory_size + args_size;
   if(data_size < 0) return 0;
   if(data_size > 2047) return 0;
   data_size &= 2047;
 
-  bpf_ringbuf_output(&queue, e, data_size + offsetof(struct exec_event, data), 0);
+  // a directory counts as sent only when the event was not dropped
+  if(output_event(e, data_size + offsetof(struct exec_event, data)) == 0 && !cached) {
+    u8 sent = 1;
+    bpf_map_update_elem(&cwd_cache, &cwd, &sent, BPF_ANY);
+  }
+  return 0;
+}
+
+#define S_IFMT 0170000
+#define S_IFDIR 0040000
+
+// Renames of files, the most common ones, change no working directory and keep the cache
+static inline void count_directory_move(struct dentry *dentry) {
+  if ((BPF_CORE_READ(dentry, d_inode, i_mode) & S_IFMT) == S_IFDIR)
+    __sync_fetch_and_add(&renames, 1);
+}
+
+// Counted after the move, an exec which reads the old count resolves the path again after it
+SEC("fexit/d_move")
+int BPF_PROG(handle_d_move, struct dentry *dentry, struct dentry *target) {
+  count_directory_move(dentry);
+  return 0;
+}
+
+// RENAME_EXCHANGE swaps two entries, either of them can be a directory
+SEC("fexit/d_exchange")
+int BPF_PROG(handle_d_exchange, struct dentry *dentry1, struct dentry *dentry2) {
+  count_directory_move(dentry1);
+  count_directory_move(dentry2);
   return 0;
 }
 
 SEC("tp/sched/sched_process_fork")
 int handle_fork(struct trace_event_raw_sched_process_fork *ctx) {
-  if (!is_process_traced()) return 0;
+  u32 *traced = current_session(PROGRAM_FORK);
+  if (traced == NULL) return 0;
+  u32 session = *traced;
 
   pid_t parent = ctx->parent_pid;
   pid_t child = ctx->child_pid;
-  int value = 0;
+  flush_staged_writes_of(parent);
 
-  bpf_map_update_elem(&processes, &child, &value, BPF_ANY);
+  bpf_map_update_elem(&processes, &child, &session, BPF_ANY);
   struct fork_event *event =
-      bpf_ringbuf_reserve(&queue, sizeof(struct fork_event), 0);
+      reserve_event(sizeof(struct fork_event));
   if (event == NULL) return 0;
-  make_fork_event(event, parent, child);
+  make_fork_event(event, session, parent, child);
   bpf_ringbuf_submit(event, 0);
   return 0;
 }
 
 SEC("tp/sched/sched_process_exit")
 int handle_exit(struct trace_event_raw_sched_process_template *ctx) {
-  if (!is_process_traced()) return 0;
+  u32 *traced = current_session(PROGRAM_EXIT);
+  if (traced == NULL) return 0;
+  u32 session = *traced;
   pid_t pid = ctx->pid;
+  flush_staged_writes_of(pid);
   struct exit_event *event =
-      bpf_ringbuf_reserve(&queue, sizeof(struct exit_event), 0);
+      reserve_event(sizeof(struct exit_event));
   if (event == NULL) return 0;
   struct task_struct *task = (struct task_struct *) bpf_get_current_task();
-  make_exit_event(event, pid, (BPF_CORE_READ(task, exit_code) >> 8) & 0xFF);
+  make_exit_event(event, session, pid, (BPF_CORE_READ(task, exit_code) >> 8) & 0xFF);
+  if (profile_scheduling) {
+    struct scheduling_data *data = bpf_map_lookup_elem(&scheduling, &pid);
+    if (data != NULL) {
+      // the process is still on cpu when it exits
+      if (data->switched_in)
+        data->stats.on_cpu_ns += event->timestamp - data->switched_in;
+      event->scheduling = data->stats;
+      event->has_scheduling_stats = 1;
+      bpf_map_delete_elem(&scheduling, &pid);
+    }
+  }
   bpf_ringbuf_submit(event, 0);
   bpf_map_delete_elem(&processes, &pid);
   return 0;
 }
 
+// Low bits of prev_state which mean that the task went to sleep.
+// Preempted tasks report none of them and go straight back to the runqueue.
+#define TASK_REPORT_MASK 0x7f
+
+static inline struct scheduling_data *traced_scheduling_data(pid_t pid) {
+  if (pid == 0) return NULL;
+  if (bpf_map_lookup_elem(&processes, &pid) == NULL) return NULL;
+  struct scheduling_data *data = bpf_map_lookup_elem(&scheduling, &pid);
+  if (data != NULL) return data;
+  struct scheduling_data empty = {};
+  bpf_map_update_elem(&scheduling, &pid, &empty, BPF_NOEXIST);
+  return bpf_map_lookup_elem(&scheduling, &pid);
+}
+
+static inline u32 runqueue_bucket(u64 latency_ns) {
+  u64 us = latency_ns / 1000;
+  u32 bucket = 0;
+  for (int i = 0; i < RUNQUEUE_HISTOGRAM_BUCKETS - 1; i++) {
+    if (us <= 1) break;
+    us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+SEC("tp/sched/sched_switch")
+int handle_sched_switch(struct trace_event_raw_sched_switch *ctx) {
+  u64 now = bpf_ktime_get_ns();
+
+  struct scheduling_data *prev = traced_scheduling_data(ctx->prev_pid);
+  if (prev != NULL) {
+    if (prev->switched_in)
+      prev->stats.on_cpu_ns += now - prev->switched_in;
+    prev->switched_in = 0;
+    prev->switched_out = now;
+    if ((ctx->prev_state & TASK_REPORT_MASK) == 0)
+      prev->enqueued = now;
+  }
+
+  struct scheduling_data *next = traced_scheduling_data(ctx->next_pid);
+  if (next != NULL) {
+    if (next->switched_out)
+      next->stats.off_cpu_ns += now - next->switched_out;
+    if (next->enqueued) {
+      u64 latency = now - next->enqueued;
+      u32 bucket = runqueue_bucket(latency);
+      next->stats.runqueue_ns += latency;
+      if (bucket < RUNQUEUE_HISTOGRAM_BUCKETS)
+        next->stats.runqueue_histogram[bucket]++;
+    }
+    next->switched_out = 0;
+    next->enqueued = 0;
+    next->switched_in = now;
+  }
+  return 0;
+}
+
+static inline void handle_wakeup(pid_t pid) {
+  struct scheduling_data *data = traced_scheduling_data(pid);
+  if (data != NULL && !data->enqueued)
+    data->enqueued = bpf_ktime_get_ns();
+}
+
+// Staged writes must not wait for a task that sleeps or moves to another cpu
+SEC("tp/sched/sched_switch")
+int flush_on_switch(struct trace_event_raw_sched_switch *ctx) {
+  flush_staged_writes_of(ctx->prev_pid);
+  return 0;
+}
+
+// Runs every stage_flush_ns / 2 on every cpu, so that staged writes are not kept
+// by a task which keeps running without writing again
+SEC("perf_event")
+int flush_on_tick(struct bpf_perf_event_data *ctx) {
+  u32 key = 0;
+  struct write_event *staged = bpf_map_lookup_elem(&staged_writes, &key);
+  if (staged != NULL && staged->size > 0 && bpf_ktime_get_ns() - staged->timestamp > stage_flush_ns)
+    flush_staged_write(staged);
+  return 0;
+}
+
+SEC("tp/sched/sched_wakeup")
+int handle_sched_wakeup(struct trace_event_raw_sched_wakeup_template *ctx) {
+  handle_wakeup(ctx->pid);
+  return 0;
+}
+
+SEC("tp/sched/sched_wakeup_new")
+int handle_sched_wakeup_new(struct trace_event_raw_sched_wakeup_template *ctx) {
+  handle_wakeup(ctx->pid);
+  return 0;
+}
+
 // from /sys/kernel/debug/tracing/events/syscalls/sys_enter_write/format
 struct write_enter_ctx {
   struct trace_entry ent;
@@ -198,26 +494,21 @@ struct write_exit_ctx {
 
 SEC("tp/syscalls/sys_enter_write")
 int handle_write_enter(struct write_enter_ctx *ctx) {
-  if (!is_process_traced()) return 0;
+  u32 *traced = current_session(PROGRAM_WRITE_ENTER);
+  if (traced == NULL) return 0;
+  u32 session = *traced;
 
   struct task_struct *task = (void *) bpf_get_current_task();
 
   struct file *dst;
   bpf_probe_read_kernel(&dst, sizeof(dst), (struct file **) BPF_CORE_READ(task, files, fdt, fd) + ctx->fd);
-  u32 stdout_id = 0;
-  u32 stderr_id = 1;
-  struct file *stdout, *stderr;
-  struct file **f = bpf_map_lookup_elem(&tracked_descriptors, &stdout_id);
-  if(f == NULL) return 0;
-  stdout = *f;
-  f = bpf_map_lookup_elem(&tracked_descriptors, &stderr_id);
-  if(f == NULL) return 0;
-  stderr = *f;
+  struct session_descriptors *descriptors = bpf_map_lookup_elem(&tracked_descriptors, &session);
+  if(descriptors == NULL) return 0;
 
   enum descriptor fd;
-  if(dst == stdout)
+  if(dst == descriptors->stdout)
     fd = STDOUT;
-  else if(dst == stderr)
+  else if(dst == descriptors->stderr)
     fd = STDERR;
   else return 0;
 
@@ -226,6 +517,7 @@ int handle_write_enter(struct write_enter_ctx *ctx) {
   struct write_data data = {
     .buf = ctx->buf,
     .fd = fd,
+    .session = session,
   };
   bpf_map_update_elem(&writes, &pid, &data, BPF_ANY);
   return 0;
@@ -235,7 +527,7 @@ int handle_write_enter(struct write_enter_ctx *ctx) {
 
 SEC("tp/syscalls/sys_exit_write")
 int handle_write_exit(struct write_exit_ctx *ctx) {
-  if (!is_process_traced()) return 0;
+  if (current_session(PROGRAM_WRITE_EXIT) == NULL) return 0;
 
   pid_t pid = bpf_get_current_pid_tgid();
 
@@ -251,13 +543,56 @@ int handle_write_exit(struct write_exit_ctx *ctx) {
 
   u32 key = 0;
 
+  if (stage_writes) {
+    struct write_event *staged = bpf_map_lookup_elem(&staged_writes, &key);
+    if (staged == NULL) return 0;
+    if (staged->size > 0 && (staged->proc != pid || staged->fd != data->fd
+          || bpf_ktime_get_ns() - staged->timestamp > stage_flush_ns))
+      flush_staged_write(staged);
+
+    u32 offset = staged->size;
+    if (offset >= WRITE_STAGE_SIZE) return 0;
+    // the batch keeps the timestamp of its first write
+    if (offset == 0)
+      make_write_event(staged, data->session, pid, data->fd, 0);
+    if (bpf_probe_read_user(staged->data + offset, wsize, data->buf)) return 0;
+    staged->size = offset + wsize;
+    if (staged->size >= WRITE_STAGE_SIZE)
+      flush_staged_write(staged);
+    return 0;
+  }
+
   // Kernel correctness checker requires extra copy via auxillary array.
   struct write_event *e = bpf_map_lookup_elem(&aux_maps, &key);
   if (e == NULL) return 0;
 
-  make_write_event(e, pid, data->fd, wsize);
+  make_write_event(e, data->session, pid, data->fd, wsize);
   if (bpf_probe_read_user(e->data, wsize, data->buf)) return 0;
 
-  bpf_ringbuf_output(&queue, e, wsize + offsetof(struct write_event, data), 0);
+  output_event(e, wsize + offsetof(struct write_event, data));
+  return 0;
+}
+
+/**
+ * Saves the current standard output and error of the requested process as the descriptors of its session.
+ * Used when attaching to a running process, which is past its first exec.
+ */
+SEC("iter/task")
+int resolve_descriptors(struct bpf_iter__task *ctx) {
+  struct task_struct *task = ctx->task;
+  if (task == NULL) return 0;
+
+  u32 key = 0;
+  struct attach_request *request = bpf_map_lookup_elem(&attach_request, &key);
+  if (request == NULL || BPF_CORE_READ(task, pid) != request->pid) return 0;
+
+  struct file **fdt = BPF_CORE_READ(task, files, fdt, fd);
+  struct session_descriptors descriptors;
+  if (bpf_probe_read_kernel(&descriptors.stdout, sizeof(descriptors.stdout), fdt + 1))
+    return 0;
+  if (bpf_probe_read_kernel(&descriptors.stderr, sizeof(descriptors.stderr), fdt + 2))
+    return 0;
+  u32 session = request->session;
+  bpf_map_update_elem(&tracked_descriptors, &session, &descriptors, BPF_ANY);
   return 0;
 }
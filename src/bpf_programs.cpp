@@ -0,0 +1,227 @@
+#include "bpf_programs.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "backend/event.h"
+#include "bpf_provider.hpp"
+
+bpf_programs::bpf_programs(bpf_provider_options const& options, sample_function sample, void *ctx) {
+  skel = tracer::open();
+  if (skel == nullptr)
+    throw std::runtime_error{"Failed to open BPF programs"};
+
+  skel->rodata->profile_scheduling = options.profile_scheduling;
+  bpf_program__set_autoload(skel->progs.handle_sched_switch, options.profile_scheduling);
+  bpf_program__set_autoload(skel->progs.handle_sched_wakeup, options.profile_scheduling);
+  bpf_program__set_autoload(skel->progs.handle_sched_wakeup_new, options.profile_scheduling);
+  if (!options.profile_scheduling)
+    bpf_map__set_max_entries(skel->maps.scheduling, 1);
+
+  skel->rodata->stage_writes = options.stage_writes;
+  skel->rodata->stage_flush_ns = options.stage_flush.count();
+  bpf_program__set_autoload(skel->progs.flush_on_switch, options.stage_writes);
+  bpf_program__set_autoload(skel->progs.flush_on_tick, options.stage_writes);
+  skel->rodata->collect_stats = options.program_stats;
+
+  if (tracer::load(skel)) {
+    tracer::destroy(skel);
+    throw std::runtime_error{"Failed to load BPF programs"};
+  }
+  tracer::attach(skel);
+  buffer = ring_buffer__new(bpf_map__fd(skel->maps.queue), sample, ctx, nullptr);
+
+  if (options.stage_writes && !attach_flush_ticks(options.stage_flush)) {
+    release();
+    throw std::runtime_error{"Failed to attach the timers flushing staged writes"};
+  }
+
+  if (options.program_stats) {
+    stats_fd = bpf_enable_stats(BPF_STATS_RUN_TIME);
+    if (stats_fd < 0) {
+      release();
+      throw std::runtime_error{"Failed to enable the statistics of BPF programs"};
+    }
+  }
+}
+
+bool bpf_programs::attach_flush_ticks(std::chrono::nanoseconds stage_flush) {
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_SOFTWARE;
+  attr.config = PERF_COUNT_SW_CPU_CLOCK;
+  // a batch waits at most one and a half times stage_flush
+  attr.sample_period = std::max<uint64_t>(stage_flush.count() / 2, 1);
+  for (int cpu = 0; cpu < libbpf_num_possible_cpus(); cpu++) {
+    int fd = syscall(SYS_perf_event_open, &attr, -1, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0 && errno == ENODEV)
+      continue;  // the cpu is offline
+    if (fd < 0)
+      return false;
+    // the link owns the perf event
+    bpf_link *link = bpf_program__attach_perf_event(skel->progs.flush_on_tick, fd);
+    if (link == nullptr) {
+      close(fd);
+      return false;
+    }
+    flush_ticks.push_back(link);
+  }
+  return true;
+}
+
+void bpf_programs::release() {
+  if (stats_fd >= 0)
+    close(stats_fd);
+  for (bpf_link *link : flush_ticks)
+    bpf_link__destroy(link);
+  ring_buffer__free(buffer);
+  tracer::detach(skel);
+  tracer::destroy(skel);
+}
+
+bpf_programs::~bpf_programs() {
+  release();
+}
+
+void bpf_programs::poll(int timeout) {
+  ring_buffer__poll(buffer, timeout);
+}
+
+int bpf_programs::processes_fd() const {
+  return bpf_map__fd(skel->maps.processes);
+}
+
+uint64_t bpf_programs::dropped_events() const {
+  return skel->bss->dropped_events;
+}
+
+size_t bpf_programs::available_bytes() const {
+  return ring__avail_data_size(ring_buffer__ring(buffer, 0));
+}
+
+int bpf_programs::epoll_fd() const {
+  return ring_buffer__epoll_fd(buffer);
+}
+
+std::vector<program_stats> bpf_programs::program_statistics() const {
+  std::vector<program_stats> result;
+  if (stats_fd < 0)
+    return result;
+
+  std::vector<uint64_t> untraced(libbpf_num_possible_cpus());
+  std::pair<bpf_program *, int> programs[] = {
+    {skel->progs.handle_exec, backend::PROGRAM_EXEC},
+    {skel->progs.handle_fork, backend::PROGRAM_FORK},
+    {skel->progs.handle_exit, backend::PROGRAM_EXIT},
+    {skel->progs.handle_write_enter, backend::PROGRAM_WRITE_ENTER},
+    {skel->progs.handle_write_exit, backend::PROGRAM_WRITE_EXIT},
+    {skel->progs.handle_sched_switch, -1},
+    {skel->progs.handle_sched_wakeup, -1},
+    {skel->progs.handle_sched_wakeup_new, -1},
+    {skel->progs.flush_on_switch, -1},
+    {skel->progs.flush_on_tick, -1},
+  };
+  for (auto [program, index] : programs) {
+    int fd = bpf_program__fd(program);
+    if (fd < 0)
+      continue;
+    bpf_prog_info info{};
+    uint32_t size = sizeof(info);
+    if (bpf_prog_get_info_by_fd(fd, &info, &size))
+      continue;
+
+    program_stats stats{bpf_program__name(program), info.run_cnt, info.run_time_ns};
+    uint32_t key = index;
+    if (index >= 0 && bpf_map_lookup_elem(bpf_map__fd(skel->maps.untraced_invocations), &key, untraced.data()) == 0) {
+      stats.untraced = 0;
+      for (uint64_t count : untraced)
+        *stats.untraced += count;
+    }
+    result.push_back(std::move(stats));
+  }
+  return result;
+}
+
+void bpf_programs::resolve_descriptors(pid_t pid, uint32_t session) {
+  struct {
+    pid_t pid;
+    uint32_t session;
+  } request{pid, session};
+  uint32_t key = 0;
+  bpf_map_update_elem(bpf_map__fd(skel->maps.attach_request), &key, &request, BPF_ANY);
+
+  // the program runs for every task while the iterator is read
+  bpf_link *link = bpf_program__attach_iter(skel->progs.resolve_descriptors, nullptr);
+  if (link == nullptr)
+    throw std::runtime_error{"Failed to attach the task iterator"};
+  int iterator = bpf_iter_create(bpf_link__fd(link));
+  char buffer[64];
+  while (iterator >= 0 && read(iterator, buffer, sizeof(buffer)) > 0)
+    ;
+  if (iterator >= 0)
+    close(iterator);
+  bpf_link__destroy(link);
+  if (iterator < 0)
+    throw std::runtime_error{"Failed to run the task iterator"};
+}
+
+void bpf_programs::end_session(uint32_t session) {
+  int processes = bpf_map__fd(skel->maps.processes);
+  std::vector<pid_t> pids;
+  pid_t pid;
+  uint32_t value;
+  for (int found = bpf_map_get_next_key(processes, nullptr, &pid); found == 0;
+       found = bpf_map_get_next_key(processes, &pid, &pid)) {
+    if (bpf_map_lookup_elem(processes, &pid, &value) == 0 && value == session)
+      pids.push_back(pid);
+  }
+  // processes which outlived their run would keep sending records nobody receives
+  for (pid_t p : pids) {
+    bpf_map_delete_elem(processes, &p);
+    bpf_map_delete_elem(bpf_map__fd(skel->maps.writes), &p);
+    bpf_map_delete_elem(bpf_map__fd(skel->maps.scheduling), &p);
+  }
+  bpf_map_delete_elem(bpf_map__fd(skel->maps.tracked_descriptors), &session);
+}
+
+void bpf_programs::pin(std::filesystem::path const& directory) {
+  auto path = directory / "processes";
+  // left by a daemon which did not exit cleanly
+  std::filesystem::remove(path);
+  if (bpf_map__pin(skel->maps.processes, path.c_str()))
+    throw std::runtime_error{"Failed to pin the BPF maps in " + directory.string()};
+}
+
+void bpf_programs::unpin(std::filesystem::path const& directory) {
+  bpf_map__unpin(skel->maps.processes, (directory / "processes").c_str());
+}
+
+void print_program_stats(std::ostream& os, std::vector<program_stats> const& stats) {
+  if (stats.empty())
+    return;
+  os << "[bpf_programs] " << std::left << std::setw(24) << "program" << std::right
+     << std::setw(14) << "runs" << std::setw(14) << "total ms" << std::setw(10) << "avg ns"
+     << std::setw(14) << "untraced" << "\n";
+  for (auto const& s : stats) {
+    os << "[bpf_programs] " << std::left << std::setw(24) << s.name << std::right
+       << std::setw(14) << s.run_count
+       << std::setw(14) << std::fixed << std::setprecision(1) << s.run_time_ns / 1e6
+       << std::setw(10) << (s.run_count > 0 ? s.run_time_ns / s.run_count : 0)
+       << std::setw(14) << (s.untraced.has_value() ? std::to_string(s.untraced.value()) : "-") << "\n";
+  }
+}
+
+bool trace_process(int processes_fd, pid_t pid, uint32_t session) {
+  return bpf_map_update_elem(processes_fd, &pid, &session, BPF_NOEXIST) == 0;
+}
@@ -1,18 +1,34 @@
 #include "bpf_provider.hpp"
 
+#include <poll.h>
+#include <sys/fsuid.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/sysinfo.h>
+#include <sys/un.h>
 #include <unistd.h>
-#include <pwd.h>
 
+#include <algorithm>
+#include <cstring>
+#include <ctime>
 #include <iostream>
 #include <thread>
 #include <stdexcept>
 
 #include <boost/lockfree/spsc_queue.hpp>
+#include <bpf/bpf.h>
 
 #include "backend/event.h"
+#include "bpf_programs.hpp"
+#include "daemon_protocol.hpp"
+#include "pipeline_stats.hpp"
+#include "process_tree.hpp"
+#include "trace_recording.hpp"
+#include "string_pool.hpp"
+
+static_assert(int{pipeline_stats::FORK} == int{backend::FORK} && int{pipeline_stats::EXIT} == int{backend::EXIT}
+  && int{pipeline_stats::EXEC} == int{backend::EXEC} && int{pipeline_stats::WRITE} == int{backend::WRITE});
 
 void static_init() {
   static bool called = false;
@@ -34,13 +50,32 @@ void static_init() {
 }
 
 
-bpf_provider::bpf_provider() : interthread_queue{2048} {
+bpf_provider::bpf_provider(bpf_provider_options options) : options(options), interthread_queue{2048} {
   static_init();
 
-  skel = tracer::open_and_load();
-  tracer::attach(skel);
-  buffer = ring_buffer__new(bpf_map__fd(skel->maps.queue), buf_process_sample,
-                            this, nullptr);
+  if (options.daemon_socket.has_value()) {
+    connect_to_daemon(options.daemon_socket.value());
+  } else {
+    programs = std::make_unique<bpf_programs>(options, buf_process_sample, this);
+    processes_fd = programs->processes_fd();
+    session = LOCAL_SESSION;
+  }
+
+  if (options.stats)
+    options.stats->set_clock_origin(decoder.boot());
+
+  if (options.record.has_value()) {
+    auto const& path = options.record.value();
+    // the recording is opened with the permissions of the user, not of root
+    int fsgid = setfsgid(getgid());
+    int fsuid = setfsuid(getuid());
+    recording.open(path, std::ios::binary | std::ios::trunc);
+    setfsuid(fsuid);
+    setfsgid(fsgid);
+    if (!recording)
+      throw std::runtime_error{"Cannot open " + path.string()};
+    trace_recording::write_header(recording, decoder.boot());
+  }
 };
 
 void bpf_provider::main_loop() {
@@ -49,18 +84,87 @@ void bpf_provider::main_loop() {
   // probably also breaks posix
   setpriority(PRIO_PROCESS, gettid(), -20);
 
-  while(!tracked_processes.empty() || !messages.empty()) {
-    while (messages.empty() || interthread_queue.write_available() == 0) 
-      ring_buffer__poll(buffer, 100);
+  // a pending write has to be flushed soon after its window expires
+  auto window = std::chrono::duration_cast<std::chrono::milliseconds>(options.coalesce_window).count();
+  int pending_poll_timeout = std::clamp<int>(window, 1, 100);
+
+  while((!tracked_processes.empty() && !disconnected) || !messages.empty()) {
+    while (messages.empty() || interthread_queue.write_available() == 0) {
+      if (options.stats && programs) {
+        options.stats->ring_occupancy.record(programs->available_bytes());
+        options.stats->set_dropped(programs->dropped_events());
+      }
+      poll(pending.has_value() ? pending_poll_timeout : 100);
+      flush_expired_write();
+      if (disconnected)
+        break;
+    }
+    if (options.stats)
+      options.stats->messages_depth.record(messages.size());
     while(!messages.empty() && interthread_queue.write_available() > 0) {
       auto message = messages.front();
       messages.pop();
       interthread_queue.push(std::move(message));
     }
   }
+  if (programs && options.program_stats) {
+    final_program_stats = programs->program_statistics();
+    print_program_stats(std::cerr, final_program_stats);
+  }
+  // the daemon does not share its counter
+  if (programs && programs->dropped_events() > 0)
+    std::cerr << "[bpf_provider] " << programs->dropped_events() << " events were lost, the ring buffer was full\n";
   active = false;
-  tracer::detach(skel);
-  tracer::destroy(skel);
+  programs.reset();
+  if (daemon >= 0) {
+    close(processes_fd);
+    close(daemon);
+  }
+}
+
+void bpf_provider::connect_to_daemon(std::filesystem::path const& socket_path) {
+  daemon = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  sockaddr_un address{.sun_family = AF_UNIX};
+  if (socket_path.native().size() >= sizeof(address.sun_path))
+    throw std::runtime_error{"Socket path is too long: " + socket_path.string()};
+  std::strcpy(address.sun_path, socket_path.c_str());
+  if (connect(daemon, reinterpret_cast<sockaddr *>(&address), sizeof(address)))
+    throw std::runtime_error{"Cannot connect to the daemon at " + socket_path.string()};
+
+  daemon_protocol::ready ready;
+  if (recv(daemon, &ready, sizeof(ready), 0) != sizeof(ready)
+      || ready.magic != daemon_protocol::MAGIC || ready.version != daemon_protocol::VERSION)
+    throw std::runtime_error{"Unexpected response of the daemon at " + socket_path.string()};
+  session = ready.session;
+
+  processes_fd = bpf_obj_get((daemon_protocol::PIN_DIRECTORY / "processes").c_str());
+  if (processes_fd < 0)
+    throw std::runtime_error{"Cannot open the BPF maps pinned by the daemon"};
+}
+
+void bpf_provider::poll(int timeout) {
+  if (programs)
+    programs->poll(timeout);
+  else
+    receive_from_daemon(timeout);
+}
+
+void bpf_provider::receive_from_daemon(int timeout) {
+  if (disconnected)
+    return;
+  pollfd readable{daemon, POLLIN};
+  if (::poll(&readable, 1, timeout) <= 0)
+    return;
+
+  alignas(8) char record[daemon_protocol::MAX_RECORD_SIZE];
+  ssize_t size;
+  while ((size = recv(daemon, record, sizeof(record), MSG_DONTWAIT)) > 0)
+    buf_process_sample(this, record, size);
+  if (size == 0) {
+    std::cerr << "[bpf_provider] The daemon closed the connection\n";
+    flush_pending_write();
+    disconnected = true;
+  }
 }
 
 
@@ -74,10 +178,12 @@ bool bpf_provider::is_active() {
 
 std::optional<events::event> bpf_provider::provide() {
   events::event result;
-  if(interthread_queue.pop(result))
+  if(interthread_queue.pop(result)) {
+    if (options.stats)
+      options.stats->queue_depth.record(interthread_queue.read_available());
     return {std::move(result)};
-  else
-    return {};
+  }
+  return {};
 }
 
 static void fix_user() {
@@ -117,12 +223,9 @@ void bpf_provider::run(char *argv[]) {
   dup2(stderr_pipe[1], STDERR_FILENO);
 
   pid_t child = fork();
-  int value = 0;
 
   if (child == 0) {
-    pid_t pid = getpid();
-    bpf_map__update_elem(skel->maps.processes, &pid, sizeof(pid), &value,
-                         sizeof(value), BPF_ANY);
+    trace_process(processes_fd, getpid(), session);
     fix_user();
     execvp(argv[0], argv);
     throw std::runtime_error{"execvp() failed"};
@@ -134,91 +237,146 @@ void bpf_provider::run(char *argv[]) {
   receiver_thread = std::thread {&bpf_provider::main_loop, this};
 }
 
-/**
- * The timestamps returned in events are relative to system boot time.
- * To return meaningful timestamps we have to get boot time from kernel, which
- * is done here.
- */
-std::chrono::system_clock::time_point get_boot_time() {
-  struct stat kernel_proc_entry;
-  int err = stat("/proc/1", &kernel_proc_entry);
-  if (err) throw std::runtime_error("Failed to fetch last boot time");
-
-  auto seconds_part = std::chrono::seconds{kernel_proc_entry.st_ctim.tv_sec};
-  auto nanoseconds_part =
-      std::chrono::nanoseconds{kernel_proc_entry.st_ctim.tv_nsec};
-
-  return std::chrono::system_clock::time_point(seconds_part + nanoseconds_part);
+bool bpf_provider::register_process(pid_t pid) {
+  if (!trace_process(processes_fd, pid, session))
+    return false;
+  // The exit program removes a process from the map after reporting it. A process which has
+  // exited and is still in the map exited before it was registered and no exit will come for it.
+  if (process_exited(pid) && bpf_map_delete_elem(processes_fd, &pid) == 0)
+    return false;
+  tracked_processes.insert(pid);
+  return true;
 }
 
-std::chrono::system_clock::time_point into_timestamp(uint64_t event_timestamp) {
-  static auto boot_time = get_boot_time();
-  auto duration_to_event = std::chrono::nanoseconds{event_timestamp};
-  return boot_time + duration_to_event;
+void bpf_provider::attach(pid_t pid) {
+  if (!programs)
+    throw std::runtime_error{"Attaching to a process is not supported with the daemon"};
+  struct stat process;
+  if (stat(("/proc/" + std::to_string(pid)).c_str(), &process))
+    throw std::runtime_error{"No process " + std::to_string(pid)};
+  // the program runs as root, the user may only attach to their own processes
+  if (getuid() != 0 && process.st_uid != getuid())
+    throw std::runtime_error{"Cannot attach to a process of another user"};
+
+  // Processes forked while the tree is registered are found by the next walk,
+  // the ones forked after their parent is registered are reported by the BPF programs
+  std::vector<process_snapshot> attached;
+  bool added = true;
+  while (added) {
+    added = false;
+    for (auto& process : read_process_tree(pid)) {
+      if (tracked_processes.contains(process.pid) || !register_process(process.pid))
+        continue;
+      for (pid_t thread : process.threads)
+        register_process(thread);
+      attached.push_back(std::move(process));
+      added = true;
+    }
+  }
+  if (attached.empty())
+    throw std::runtime_error{"No process " + std::to_string(pid)};
+  programs->resolve_descriptors(pid, session);
+
+  auto now = std::chrono::system_clock::now();
+  for (auto const& process : attached) {
+    if (process.pid != pid)
+      messages.push(events::fork_event{process.parent, now, process.pid});
+    messages.push(from(process, now));
+    for (pid_t thread : process.threads)
+      if (tracked_processes.contains(thread))
+        messages.push(events::fork_event{process.pid, now, thread});
+  }
+
+  active = true;
+  receiver_thread = std::thread {&bpf_provider::main_loop, this};
 }
 
-static events::write_event from(const backend::write_event *e) {
-  events::write_event::descriptor fd = e->fd == backend::STDOUT ? 
-    events::write_event::descriptor::STDOUT :
-    events::write_event::descriptor::STDERR;
+events::exec_event bpf_provider::from(process_snapshot const& process, events::time_point timestamp) {
+  auto& pool = events::string_pool::global();
+  std::string_view working_directory = process.working_directory;
+  if (working_directory.empty()) working_directory = "/";
 
   return {
-    e->proc,
-    into_timestamp(e->timestamp),
-    fd,
-    {e->data, static_cast<size_t>(e->size)},
+    {
+      .source_pid = process.pid,
+      .timestamp = timestamp,
+    },
+    .user_id = process.uid,
+    .user_name = decoder.user_name(process.uid),
+    .working_directory = pool.intern(working_directory),
+    .command = pool.intern(process.command),
   };
 }
 
-static events::fork_event from(const backend::fork_event *e) {
-  return {
-      e->parent,
-      into_timestamp(e->timestamp),
-      e->child,
-  };
+void bpf_provider::push(events::event e) {
+  // the pending write happened before, the order of events has to be kept
+  flush_pending_write();
+  messages.push(std::move(e));
 }
 
-static events::exit_event from(const backend::exit_event *e) {
-  return {e->proc, into_timestamp(e->timestamp), e->code};
+void bpf_provider::push_write(const backend::write_event *e) {
+  if (options.coalesce_window.count() == 0) {
+    messages.push(decoder.decode(e));
+    return;
+  }
+
+  if (pending.has_value()) {
+    auto& p = pending.value();
+    // events from different CPUs may arrive slightly out of order
+    auto gap = static_cast<int64_t>(e->timestamp - p.last_timestamp);
+    bool mergeable = p.event.source_pid == e->proc
+      && (p.event.file_descriptor == events::write_event::descriptor::STDERR) == (e->fd == backend::STDERR)
+      && gap <= options.coalesce_window.count()
+      && p.event.data.size() + e->size <= options.coalesce_limit;
+    if (mergeable) {
+      p.event.data.append(e->data, e->size);
+      p.last_timestamp = std::max<uint64_t>(p.last_timestamp, e->timestamp);
+      return;
+    }
+    flush_pending_write();
+  }
+  pending = {decoder.decode(e), e->timestamp};
 }
 
-static events::exec_event from(const backend::exec_event *e) {
-  std::string command{e->data, e->data + e->args_size};
-  std::replace(command.begin(), command.end(), '\0', ' ');
-  std::string working_directory{e->data + e->args_size, e->data + e->args_size + e->working_directory_size};
-  if(working_directory == "") working_directory = "/";
-  struct passwd *pws = getpwuid(e->uid);
-  std::string user_name{pws->pw_name};
+void bpf_provider::flush_pending_write() {
+  if (!pending.has_value())
+    return;
+  messages.push(std::move(pending->event));
+  pending.reset();
+}
 
-  return {
-    {
-      .source_pid = e->proc,
-      .timestamp = into_timestamp(e->timestamp),
-    },
-    .user_id = 0,
-    .user_name = user_name,
-    .working_directory = working_directory,
-    .command = command,
-  };
+void bpf_provider::flush_expired_write() {
+  if (!pending.has_value())
+    return;
+  // event timestamps come from bpf_ktime_get_ns, which uses the monotonic clock
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t now_ns = now.tv_sec * 1'000'000'000ull + now.tv_nsec;
+  if (static_cast<int64_t>(now_ns - pending->last_timestamp) > options.coalesce_window.count())
+    flush_pending_write();
 }
 
 int bpf_provider::buf_process_sample(void *ctx, void *data, size_t len) {
   bpf_provider *me = static_cast<bpf_provider *>(ctx);
   const backend::event *e = static_cast<backend::event *>(data);
+  if (me->recording.is_open())
+    trace_recording::write_record(me->recording, data, len);
+  if (me->options.stats)
+    me->options.stats->received(static_cast<pipeline_stats::record_type>(e->type), len);
   switch (e->type) {
     case backend::FORK:
       me->tracked_processes.insert(e->fork.child);
-      me->messages.push(from(&(e->fork)));
+      me->push(me->decoder.decode(&(e->fork)));
       break;
     case backend::EXIT:
       me->tracked_processes.erase(e->exit.proc);
-      me->messages.push(from(&(e->exit)));
+      me->push(me->decoder.decode(&(e->exit)));
       break;
     case backend::EXEC:
-      me->messages.push(from(&(e->exec)));
+      me->push(me->decoder.decode(&(e->exec)));
       break;
     case backend::WRITE:
-      me->messages.push(from(&(e->write)));
+      me->push_write(&(e->write));
       break;
   }
   return 0;
@@ -0,0 +1,203 @@
+#include "compressed_ostream.hpp"
+
+#include <zlib.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// Every stream holds a block while it is written to, so blocks stay small
+static constexpr size_t BLOCK_SIZE = 64 * 1024;
+// The producer waits when this many blocks are pending, which bounds the memory
+// used when the events arrive faster than they can be compressed
+static constexpr size_t MAX_PENDING_BLOCKS = 32;
+
+struct compressed_ostream::target {
+  std::filesystem::path path;
+  // The file gets another gzip member, gzip readers read them as a single one
+  bool append = false;
+  std::FILE* file = nullptr;
+  z_stream stream{};
+  bool failed = false;
+
+  void open();
+  void write(std::string const& data, bool finish);
+  void close();
+};
+
+void compressed_ostream::target::open() {
+  file = std::fopen(path.c_str(), append ? "ab" : "wb");
+  // 16 selects the gzip header instead of the raw zlib one
+  if (file == nullptr || deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    std::cerr << "[compressed_ostream] Cannot open " << path.string() << "\n";
+    failed = true;
+  }
+}
+
+void compressed_ostream::target::write(std::string const& data, bool finish) {
+  if (file == nullptr && !failed)
+    open();
+  if (failed)
+    return;
+
+  unsigned char output[64 * 1024];
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = data.size();
+  int result;
+  do {
+    stream.next_out = output;
+    stream.avail_out = sizeof(output);
+    result = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+    size_t produced = sizeof(output) - stream.avail_out;
+    if (std::fwrite(output, 1, produced, file) != produced) {
+      std::cerr << "[compressed_ostream] Cannot write " << path.string() << "\n";
+      failed = true;
+      break;
+    }
+  } while (stream.avail_out == 0 || (finish && result != Z_STREAM_END));
+
+  if (finish || failed)
+    close();
+}
+
+void compressed_ostream::target::close() {
+  if (file == nullptr)
+    return;
+  deflateEnd(&stream);
+  std::fclose(file);
+  file = nullptr;
+}
+
+namespace {
+/**
+ * Background thread compressing the blocks of all streams.
+ * It is started on first use and drains the queue before the program exits.
+ */
+class compressor {
+  struct block {
+    std::shared_ptr<compressed_ostream::target> file;
+    std::string data;
+    bool finish;
+  };
+
+  std::mutex mutex;
+  std::condition_variable pending;
+  std::condition_variable space;
+  std::condition_variable idle;
+  std::deque<block> queue;
+  bool busy = false;
+  bool stopping = false;
+  std::thread worker;
+
+  void run() {
+    std::unique_lock lock{mutex};
+    while (true) {
+      pending.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (queue.empty())
+        return;
+      block b = std::move(queue.front());
+      queue.pop_front();
+      space.notify_one();
+      busy = true;
+
+      lock.unlock();
+      b.file->write(b.data, b.finish);
+      lock.lock();
+
+      busy = false;
+      if (queue.empty())
+        idle.notify_all();
+    }
+  }
+
+ public:
+  compressor() : worker([this] { run(); }) {}
+
+  ~compressor() {
+    {
+      std::lock_guard lock{mutex};
+      stopping = true;
+    }
+    pending.notify_one();
+    worker.join();
+  }
+
+  void submit(std::shared_ptr<compressed_ostream::target> file, std::string data, bool finish) {
+    std::unique_lock lock{mutex};
+    space.wait(lock, [this] { return queue.size() < MAX_PENDING_BLOCKS; });
+    queue.push_back({std::move(file), std::move(data), finish});
+    pending.notify_one();
+  }
+
+  void wait() {
+    std::unique_lock lock{mutex};
+    idle.wait(lock, [this] { return queue.empty() && !busy; });
+  }
+
+  static compressor& global() {
+    static compressor instance;
+    return instance;
+  }
+};
+}  // namespace
+
+compressed_ostream::block_buffer::block_buffer(std::filesystem::path path, bool append)
+    : file(std::make_shared<target>()) {
+  file->path = std::move(path);
+  file->append = append;
+}
+
+compressed_ostream::block_buffer::~block_buffer() { submit(true); }
+
+void compressed_ostream::block_buffer::next_block() {
+  // Nothing is allocated until the first write
+  if (pbase() != nullptr)
+    submit(false);
+  block.resize(BLOCK_SIZE);
+  setp(block.data(), block.data() + block.size());
+}
+
+void compressed_ostream::block_buffer::submit(bool finish) {
+  block.resize(pptr() - pbase());
+  compressor::global().submit(file, std::move(block), finish);
+  block = {};
+  setp(nullptr, nullptr);
+}
+
+compressed_ostream::block_buffer::int_type compressed_ostream::block_buffer::overflow(int_type ch) {
+  next_block();
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+std::streamsize compressed_ostream::block_buffer::xsputn(char const* data, std::streamsize count) {
+  std::streamsize written = 0;
+  while (written < count) {
+    if (pptr() == epptr())
+      next_block();
+    std::streamsize chunk = std::min<std::streamsize>(count - written, epptr() - pptr());
+    std::memcpy(pptr(), data + written, chunk);
+    pbump(chunk);
+    written += chunk;
+  }
+  return written;
+}
+
+compressed_ostream::compressed_ostream(std::filesystem::path path, bool append)
+    : std::ostream(&buffer), buffer(std::move(path), append) {}
+
+void compressed_ostream::wait_for_pending() { compressor::global().wait(); }
+
+std::unique_ptr<std::ostream> open_output_file(std::filesystem::path const& path, bool compress, bool append) {
+  if (compress)
+    return std::make_unique<compressed_ostream>(path, append);
+  return std::make_unique<std::ofstream>(path, append ? std::ios::app : std::ios::out);
+}
@@ -7,18 +7,27 @@ using namespace events;
 
 void console_logger::consume(event const& e) { std::visit(visitor, e); }
 
+void console_logger::flush() { visitor.fmt.flush(std::cout); }
+
+console_logger::~console_logger() {
+  visitor.lines.flush_all();
+  flush();
+}
+
 void console_logger::event_visitor::operator()(fork_event const& e) {
   fmt.format(std::cout, e);
 }
 
 void console_logger::event_visitor::operator()(exec_event const& e) {
+  lines.flush(e.source_pid);
   fmt.format(std::cout, e);
 }
 
 void console_logger::event_visitor::operator()(exit_event const& e) {
+  lines.flush(e.source_pid);
   fmt.format(std::cout, e);
 }
 
 void console_logger::event_visitor::operator()(write_event const& e) {
-  fmt.format(std::cout, e);
+  lines.write(e);
 }
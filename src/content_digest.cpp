@@ -0,0 +1,165 @@
+#include "content_digest.hpp"
+
+#include <cstring>
+
+static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+static uint64_t rotate_left(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// XXH64 is defined on little endian words
+static uint64_t read64(unsigned char const *data) {
+  uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static uint32_t read32(unsigned char const *data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static uint64_t mix_round(uint64_t accumulator, uint64_t input) {
+  accumulator += input * PRIME2;
+  return rotate_left(accumulator, 31) * PRIME1;
+}
+
+static uint64_t merge_round(uint64_t hash, uint64_t accumulator) {
+  hash ^= mix_round(0, accumulator);
+  return hash * PRIME1 + PRIME4;
+}
+
+xxh64::xxh64(uint64_t seed)
+    : accumulators{seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1}, seed(seed) {}
+
+void xxh64::consume_stripe(unsigned char const *data) {
+  for (int i = 0; i < 4; i++)
+    accumulators[i] = mix_round(accumulators[i], read64(data + 8 * i));
+}
+
+void xxh64::update(void const *data, size_t size) {
+  auto input = static_cast<unsigned char const *>(data);
+  length += size;
+
+  if (buffered + size < sizeof(buffer)) {
+    std::memcpy(buffer + buffered, input, size);
+    buffered += size;
+    return;
+  }
+  if (buffered > 0) {
+    size_t missing = sizeof(buffer) - buffered;
+    std::memcpy(buffer + buffered, input, missing);
+    consume_stripe(buffer);
+    input += missing;
+    size -= missing;
+    buffered = 0;
+  }
+  for (; size >= sizeof(buffer); input += sizeof(buffer), size -= sizeof(buffer))
+    consume_stripe(input);
+  std::memcpy(buffer, input, size);
+  buffered = size;
+}
+
+uint64_t xxh64::digest() const {
+  uint64_t hash;
+  if (length >= sizeof(buffer)) {
+    hash = rotate_left(accumulators[0], 1) + rotate_left(accumulators[1], 7)
+      + rotate_left(accumulators[2], 12) + rotate_left(accumulators[3], 18);
+    for (uint64_t accumulator : accumulators)
+      hash = merge_round(hash, accumulator);
+  } else {
+    hash = seed + PRIME5;
+  }
+  hash += length;
+
+  size_t i = 0;
+  for (; i + 8 <= buffered; i += 8)
+    hash = rotate_left(hash ^ mix_round(0, read64(buffer + i)), 27) * PRIME1 + PRIME4;
+  if (i + 4 <= buffered) {
+    hash = rotate_left(hash ^ (read32(buffer + i) * PRIME1), 23) * PRIME2 + PRIME3;
+    i += 4;
+  }
+  for (; i < buffered; i++)
+    hash = rotate_left(hash ^ (buffer[i] * PRIME5), 11) * PRIME1;
+
+  hash ^= hash >> 33;
+  hash *= PRIME2;
+  hash ^= hash >> 29;
+  hash *= PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+static uint64_t stream_key(pid_t pid, events::write_event::descriptor fd) {
+  return (static_cast<uint64_t>(pid) << 1) | static_cast<uint64_t>(fd);
+}
+
+void output_digest::write(events::write_event const& e) {
+  auto& s = streams.try_emplace(stream_key(e.source_pid, e.file_descriptor), e.file_descriptor).first->second;
+  std::string_view data = e.data;
+  while (!data.empty()) {
+    if (s.carriage_return && data.front() != '\n')
+      s.line.clear();
+    s.carriage_return = false;
+
+    size_t end = data.find_first_of("\r\n");
+    // Lines without a carriage return are hashed without being copied
+    if (s.line.empty() && end != std::string_view::npos && data[end] == '\n') {
+      s.hash.update(data.substr(0, end + 1));
+      data.remove_prefix(end + 1);
+      continue;
+    }
+    s.line.append(data.substr(0, end));
+    if (end == std::string_view::npos) {
+      // The stream hash does not depend on the pieces, a line without a carriage return keeps its digest
+      if (s.line.size() > MAX_LINE) {
+        s.hash.update(s.line);
+        s.line.clear();
+      }
+      break;
+    }
+    if (data[end] == '\n') {
+      s.line.push_back('\n');
+      s.hash.update(s.line);
+      s.line.clear();
+    } else {
+      s.carriage_return = true;
+    }
+    data.remove_prefix(end + 1);
+  }
+}
+
+void output_digest::finish(uint64_t key) {
+  auto s = streams.find(key);
+  if (s == streams.end())
+    return;
+  s->second.hash.update(s->second.line);
+  finished += s->second.hash.digest();
+  streams.erase(s);
+}
+
+void output_digest::exit(pid_t pid) {
+  finish(stream_key(pid, events::write_event::descriptor::STDOUT));
+  finish(stream_key(pid, events::write_event::descriptor::STDERR));
+}
+
+uint64_t output_digest::digest(events::exec_event const& program, std::optional<int> exit_code) {
+  while (!streams.empty())
+    finish(streams.begin()->first);
+
+  xxh64 result;
+  // Strings are terminated, so that a part of the command cannot pass for the directory
+  result.update(program.command);
+  result.update("", 1);
+  result.update(program.working_directory);
+  result.update("", 1);
+  int64_t numbers[] = {exit_code.has_value(), exit_code.value_or(0), static_cast<int64_t>(elided), static_cast<int64_t>(finished)};
+  result.update(numbers, sizeof(numbers));
+  return result.digest();
+}
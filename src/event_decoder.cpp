@@ -0,0 +1,156 @@
+#include "event_decoder.hpp"
+
+#include <sys/stat.h>
+#include <pwd.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "backend/event.h"
+#include "string_pool.hpp"
+
+/**
+ * The timestamps returned in events are relative to system boot time.
+ * To return meaningful timestamps we have to get boot time from kernel, which
+ * is done here.
+ */
+events::time_point event_decoder::current_boot_time() {
+  static auto boot_time = [] {
+    struct stat kernel_proc_entry;
+    int err = stat("/proc/1", &kernel_proc_entry);
+    if (err) throw std::runtime_error("Failed to fetch last boot time");
+
+    auto seconds_part = std::chrono::seconds{kernel_proc_entry.st_ctim.tv_sec};
+    auto nanoseconds_part =
+        std::chrono::nanoseconds{kernel_proc_entry.st_ctim.tv_nsec};
+
+    return events::time_point(seconds_part + nanoseconds_part);
+  }();
+  return boot_time;
+}
+
+event_decoder::event_decoder(events::time_point boot_time) : boot_time(boot_time) {}
+
+events::time_point event_decoder::timestamp(uint64_t record_timestamp) const {
+  return boot_time + std::chrono::nanoseconds{record_timestamp};
+}
+
+static events::write_event::descriptor from(backend::descriptor fd) {
+  return fd == backend::STDOUT ? 
+    events::write_event::descriptor::STDOUT :
+    events::write_event::descriptor::STDERR;
+}
+
+events::write_event event_decoder::decode(backend::write_event const *e) {
+  return {
+    e->proc,
+    timestamp(e->timestamp),
+    from(e->fd),
+    {e->data, static_cast<size_t>(e->size)},
+  };
+}
+
+events::fork_event event_decoder::decode(backend::fork_event const *e) {
+  return {
+      e->parent,
+      timestamp(e->timestamp),
+      e->child,
+  };
+}
+
+static events::sched_stats from(const backend::scheduling_stats *s) {
+  static_assert(events::runqueue_histogram_buckets == RUNQUEUE_HISTOGRAM_BUCKETS);
+
+  events::sched_stats result{
+    .on_cpu = std::chrono::nanoseconds{s->on_cpu_ns},
+    .off_cpu = std::chrono::nanoseconds{s->off_cpu_ns},
+    .runqueue = std::chrono::nanoseconds{s->runqueue_ns},
+  };
+  std::copy(std::begin(s->runqueue_histogram), std::end(s->runqueue_histogram),
+            result.runqueue_histogram.begin());
+  return result;
+}
+
+events::exit_event event_decoder::decode(backend::exit_event const *e) {
+  events::exit_event result{e->proc, timestamp(e->timestamp), e->code};
+  if (e->has_scheduling_stats)
+    result.sched = from(&e->scheduling);
+  return result;
+}
+
+std::string_view event_decoder::user_name(uid_t uid) {
+  auto it = user_names.find(uid);
+  if (it != user_names.end())
+    return it->second;
+
+  struct passwd *pws = getpwuid(uid);
+  std::string name = pws != nullptr ? pws->pw_name : std::to_string(uid);
+  std::string_view interned = events::string_pool::global().intern(name);
+  user_names.emplace(uid, interned);
+  return interned;
+}
+
+events::exec_event event_decoder::decode(backend::exec_event const *e) {
+  auto& pool = events::string_pool::global();
+
+  command.assign(e->data, e->data + e->args_size);
+  std::replace(command.begin(), command.end(), '\0', ' ');
+
+  auto const& key = e->working_directory_key;
+  std::tuple directory{key.dentry, key.mount, key.inode, key.renames};
+
+  std::string_view working_directory;
+  if (e->working_directory_cached) {
+    auto it = working_directories.find(directory);
+    // the exec which sent the path was lost
+    working_directory = it != working_directories.end() ? it->second : "?";
+  } else {
+    working_directory = {e->data + e->args_size, static_cast<size_t>(e->working_directory_size)};
+    if(working_directory.empty()) working_directory = "/";
+    working_directory = pool.intern(working_directory);
+    working_directories[directory] = working_directory;
+  }
+
+  events::exec_event result;
+  result.source_pid = e->proc;
+  result.timestamp = timestamp(e->timestamp);
+  result.user_id = e->uid;
+  result.user_name = user_name(e->uid);
+  result.working_directory = working_directory;
+  result.command = pool.intern(command);
+  return result;
+}
+
+events::event event_decoder::decode(backend::event const *e) {
+  switch (e->type) {
+    case backend::FORK:
+      return decode(&e->fork);
+    case backend::EXIT:
+      return decode(&e->exit);
+    case backend::EXEC:
+      return decode(&e->exec);
+    case backend::WRITE:
+      return decode(&e->write);
+  }
+  throw std::runtime_error{"Unknown record type " + std::to_string(e->type)};
+}
+
+bool event_decoder::valid(void const *record, size_t size) {
+  auto e = static_cast<backend::event const *>(record);
+  if (size < sizeof(backend::event_header))
+    return false;
+  switch (e->type) {
+    case backend::FORK:
+      return size >= sizeof(backend::fork_event);
+    case backend::EXIT:
+      return size >= sizeof(backend::exit_event);
+    case backend::EXEC:
+      return size >= sizeof(backend::exec_event)
+        && e->exec.args_size >= 0 && e->exec.working_directory_size >= 0
+        && static_cast<size_t>(e->exec.args_size) + e->exec.working_directory_size <= size - sizeof(backend::exec_event);
+    case backend::WRITE:
+      return size >= sizeof(backend::write_event)
+        && e->write.size >= 0 && static_cast<size_t>(e->write.size) <= size - sizeof(backend::write_event);
+  }
+  return false;
+}
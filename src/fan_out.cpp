@@ -0,0 +1,72 @@
+#include "fan_out.hpp"
+
+#include <iostream>
+#include <variant>
+
+fan_out::fan_out(size_t capacity) : capacity(capacity) {}
+
+fan_out::~fan_out() {
+  for (auto& c : channels) {
+    while (!drain(*c) && !c->failed)
+      std::this_thread::yield();
+    c->closed = true;
+    c->pushed.fetch_add(1);
+    c->pushed.notify_one();
+  }
+  for (auto& c : channels) {
+    c->worker.join();
+    if (c->dropped_writes > 0)
+      std::cerr << "[fan_out] " << c->dropped_writes << " writes were dropped by the " << c->name
+                << " output, which could not keep up\n";
+  }
+}
+
+void fan_out::report_failure(channel const& c, std::exception const& e) {
+  std::cerr << "[fan_out] The " << c.name << " output stopped: " << e.what() << "\n";
+}
+
+bool fan_out::push(channel& c, item const& i) {
+  if (!c.queue.push(i))
+    return false;
+  c.pushed.fetch_add(1, std::memory_order_release);
+  c.pushed.notify_one();
+  return true;
+}
+
+bool fan_out::drain(channel& c) {
+  for (; !c.backlog.empty(); c.backlog.pop_front())
+    if (!push(c, c.backlog.front()))
+      return false;
+  while (!c.elided.empty()) {
+    auto first = c.elided.begin();
+    if (!push(c, elided_writes{first->first, first->second}))
+      return false;
+    c.elided.erase(first);
+  }
+  return true;
+}
+
+void fan_out::consume(events::event e) {
+  auto shared = std::make_shared<events::event const>(std::move(e));
+  auto write = std::get_if<events::write_event>(shared.get());
+  for (auto& c : channels) {
+    if (c->failed) {
+      c->backlog.clear();
+      c->elided.clear();
+      continue;
+    }
+    // The earlier items come first, so that a gap is where the output went missing
+    if (drain(*c) && push(*c, shared))
+      continue;
+    if (write != nullptr) {
+      c->dropped_writes++;
+      auto& elided = c->elided.try_emplace(write->source_pid, output_elided{write->timestamp, 0}).first->second;
+      elided.bytes += write->data.size();
+      continue;
+    }
+    for (auto const& [pid, elided] : c->elided)
+      c->backlog.push_back(elided_writes{pid, elided});
+    c->elided.clear();
+    c->backlog.push_back(shared);
+  }
+}
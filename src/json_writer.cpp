@@ -0,0 +1,178 @@
+#include "json_writer.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstring>
+
+// Blocks written to the stream are about this large
+static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+json_writer::json_writer(std::ostream& os) : os(os) {
+  buffer.reserve(2 * FLUSH_THRESHOLD);
+}
+
+json_writer::~json_writer() { flush(); }
+
+void json_writer::separate() {
+  if (need_comma) buffer.push_back(',');
+  need_comma = true;
+}
+
+void json_writer::begin_object() {
+  separate();
+  buffer.push_back('{');
+  need_comma = false;
+}
+
+void json_writer::end_object() {
+  buffer.push_back('}');
+  need_comma = true;
+}
+
+void json_writer::begin_array() {
+  separate();
+  buffer.push_back('[');
+  need_comma = false;
+}
+
+void json_writer::end_array() {
+  buffer.push_back(']');
+  need_comma = true;
+}
+
+void json_writer::key(std::string_view name) {
+  separate();
+  buffer.push_back('"');
+  buffer.append(name);
+  buffer.append("\":");
+  need_comma = false;
+}
+
+void json_writer::value(std::string_view str) {
+  separate();
+  write_escaped(str);
+}
+
+void json_writer::value(int64_t number) {
+  separate();
+  char digits[24];
+  auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), number);
+  buffer.append(digits, end);
+}
+
+void json_writer::value(uint64_t number) {
+  separate();
+  char digits[24];
+  auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), number);
+  buffer.append(digits, end);
+}
+
+void json_writer::value(bool flag) {
+  separate();
+  buffer.append(flag ? "true" : "false");
+}
+
+void json_writer::fixed_point(int64_t value, int decimals) {
+  separate();
+  if (value < 0) {
+    buffer.push_back('-');
+    value = -value;
+  }
+  int64_t scale = 1;
+  for (int i = 0; i < decimals; i++) scale *= 10;
+
+  char digits[24];
+  auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value / scale);
+  buffer.append(digits, end);
+  if (decimals == 0) return;
+
+  buffer.push_back('.');
+  auto [fraction_end, fraction_ec] = std::to_chars(digits, digits + sizeof(digits), value % scale);
+  buffer.append(decimals - (fraction_end - digits), '0');
+  buffer.append(digits, fraction_end);
+}
+
+void json_writer::raw(std::string_view text) {
+  buffer.append(text);
+  need_comma = false;
+}
+
+// Length of a valid UTF-8 sequence starting at str[0], 0 if it is invalid
+static size_t utf8_sequence_length(std::string_view str) {
+  unsigned char lead = str[0];
+  size_t length;
+  if ((lead & 0xE0) == 0xC0 && lead >= 0xC2) length = 2;
+  else if ((lead & 0xF0) == 0xE0) length = 3;
+  else if ((lead & 0xF8) == 0xF0 && lead <= 0xF4) length = 4;
+  else return 0;
+
+  if (str.size() < length) return 0;
+  for (size_t i = 1; i < length; i++)
+    if ((static_cast<unsigned char>(str[i]) & 0xC0) != 0x80) return 0;
+  return length;
+}
+
+// Bytes which can not be copied into a JSON string as they are
+static constexpr auto NEEDS_ESCAPE = [] {
+  std::array<bool, 256> table{};
+  for (int c = 0; c < 256; c++)
+    table[c] = c < 0x20 || c == '"' || c == '\\' || c >= 0x80;
+  return table;
+}();
+
+void json_writer::write_escaped(std::string_view str) {
+  static const char hex[] = "0123456789abcdef";
+
+  buffer.push_back('"');
+  size_t i = 0;
+  while (i < str.size()) {
+    // copy the longest run of characters which need no escaping at once
+    size_t run = i;
+    while (run < str.size() && !NEEDS_ESCAPE[static_cast<unsigned char>(str[run])])
+      run++;
+    buffer.append(str.data() + i, run - i);
+    i = run;
+    if (i == str.size()) break;
+
+    unsigned char c = str[i];
+    if (c >= 0x80) {
+      // JSON has to be valid UTF-8, anything else is replaced with U+FFFD
+      size_t length = utf8_sequence_length(str.substr(i));
+      if (length == 0) {
+        buffer.append("\\ufffd");
+        i++;
+      } else {
+        buffer.append(str.data() + i, length);
+        i += length;
+      }
+      continue;
+    }
+
+    switch (c) {
+      case '"': buffer.append("\\\""); break;
+      case '\\': buffer.append("\\\\"); break;
+      case '\n': buffer.append("\\n"); break;
+      case '\r': buffer.append("\\r"); break;
+      case '\t': buffer.append("\\t"); break;
+      default:
+        buffer.append("\\u00");
+        buffer.push_back(hex[c >> 4]);
+        buffer.push_back(hex[c & 0xF]);
+    }
+    i++;
+  }
+  buffer.push_back('"');
+}
+
+void json_writer::maybe_flush() {
+  if (buffer.size() >= FLUSH_THRESHOLD) {
+    os.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+}
+
+void json_writer::flush() {
+  os.write(buffer.data(), buffer.size());
+  buffer.clear();
+  os.flush();
+}
@@ -0,0 +1,94 @@
+#include "jsonl_logger.hpp"
+
+using namespace events;
+
+jsonl_logger::jsonl_logger(std::ostream& os) : writer(os), visitor{*this} {}
+
+jsonl_logger::~jsonl_logger() { flush(); }
+
+void jsonl_logger::consume(event const& e) { std::visit(visitor, e); }
+
+void jsonl_logger::flush() { writer.flush(); }
+
+void jsonl_logger::begin(std::string_view type, event_base const& e, process_info const& info) {
+  writer.begin_object();
+  writer.key("type");
+  writer.value(type);
+  writer.key("ts");
+  writer.value(static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(e.timestamp.time_since_epoch()).count()));
+  writer.key("pid");
+  writer.value(e.source_pid);
+  writer.key("ppid");
+  writer.value(info.ppid);
+  writer.key("group");
+  writer.value(info.group);
+}
+
+void jsonl_logger::end() {
+  writer.end_object();
+  writer.raw("\n");
+  writer.maybe_flush();
+}
+
+void jsonl_logger::event_visitor::operator()(fork_event const& e) {
+  process_info& parent = logger.processes[e.source_pid];
+  logger.processes[e.child_pid] = {e.source_pid, parent.group};
+
+  logger.begin("fork", e, parent);
+  logger.writer.key("child");
+  logger.writer.value(e.child_pid);
+  logger.end();
+}
+
+void jsonl_logger::event_visitor::operator()(exec_event const& e) {
+  process_info& info = logger.processes[e.source_pid];
+  uint64_t parent_group = info.group;
+  info.group = ++logger.last_group;
+
+  logger.begin("exec", e, info);
+  logger.writer.key("parent_group");
+  logger.writer.value(parent_group);
+  logger.writer.key("uid");
+  logger.writer.value(e.user_id);
+  logger.writer.key("user");
+  logger.writer.value(e.user_name);
+  logger.writer.key("cwd");
+  logger.writer.value(e.working_directory);
+  logger.writer.key("command");
+  logger.writer.value(e.command);
+  logger.end();
+}
+
+void jsonl_logger::event_visitor::operator()(exit_event const& e) {
+  auto it = logger.processes.find(e.source_pid);
+  process_info info = it != logger.processes.end() ? it->second : process_info{};
+  if (it != logger.processes.end())
+    logger.processes.erase(it);
+
+  logger.begin("exit", e, info);
+  logger.writer.key("exit_code");
+  logger.writer.value(e.exit_code);
+  if (e.sched.has_value()) {
+    logger.writer.key("on_cpu_ns");
+    logger.writer.value(static_cast<int64_t>(e.sched->on_cpu.count()));
+    logger.writer.key("off_cpu_ns");
+    logger.writer.value(static_cast<int64_t>(e.sched->off_cpu.count()));
+    logger.writer.key("runqueue_ns");
+    logger.writer.value(static_cast<int64_t>(e.sched->runqueue.count()));
+    logger.writer.key("runqueue_histogram");
+    logger.writer.begin_array();
+    for (uint32_t count : e.sched->runqueue_histogram)
+      logger.writer.value(count);
+    logger.writer.end_array();
+  }
+  logger.end();
+}
+
+void jsonl_logger::event_visitor::operator()(write_event const& e) {
+  logger.begin("write", e, logger.processes[e.source_pid]);
+  logger.writer.key("descriptor");
+  logger.writer.value(e.file_descriptor == write_event::descriptor::STDOUT ? "stdout" : "stderr");
+  logger.writer.key("data");
+  logger.writer.value(e.data);
+  logger.end();
+}
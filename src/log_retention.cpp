@@ -0,0 +1,111 @@
+#include "log_retention.hpp"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_set>
+
+using namespace events;
+
+// Directories are renamed before they are removed, so that a removal interrupted
+// in the middle is finished by the next pass
+static const std::string REMOVED_PREFIX = ".removed-";
+
+// from linux/ioprio.h, which is not available everywhere
+static constexpr int IOPRIO_CLASS_IDLE = 3;
+static constexpr int IOPRIO_CLASS_SHIFT = 13;
+static constexpr int IOPRIO_WHO_PROCESS = 1;
+
+std::vector<std::string> expired_runs(std::vector<run_info> runs, retention_policy const& policy, time_point now) {
+  std::sort(runs.begin(), runs.end(), [](run_info const& a, run_info const& b) { return a.start > b.start; });
+
+  std::vector<std::string> result;
+  size_t kept_runs = 0;
+  uintmax_t kept_bytes = 0;
+  bool over_budget = false;
+  for (auto const& run : runs) {
+    if (policy.keep_failed && run.failed())
+      continue;
+
+    over_budget = over_budget || (policy.max_total_bytes.has_value() && kept_bytes + run.bytes > policy.max_total_bytes.value());
+    bool expired = over_budget
+      || (policy.max_age.has_value() && now - run.start > policy.max_age.value())
+      || (policy.max_runs.has_value() && kept_runs >= policy.max_runs.value());
+
+    if (expired) {
+      result.push_back(run.directory);
+    } else {
+      kept_runs++;
+      kept_bytes += run.bytes;
+    }
+  }
+  return result;
+}
+
+log_retention::log_retention(
+    std::filesystem::path logs_directory,
+    retention_policy policy,
+    std::function<void(run_journal const&)> rebuild_index)
+    : logs_directory(std::move(logs_directory)), policy(policy), rebuild_index(std::move(rebuild_index)) {
+  if (policy.enabled())
+    worker = std::thread{&log_retention::run, this};
+}
+
+log_retention::~log_retention() {
+  stopping = true;
+  if (worker.joinable())
+    worker.join();
+}
+
+void log_retention::run() {
+  setpriority(PRIO_PROCESS, gettid(), 19);
+  syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, gettid(), IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+
+  try {
+    std::error_code error;
+    // Leftovers of an interrupted pass
+    for (auto const& entry : std::filesystem::directory_iterator(logs_directory, error)) {
+      if (stopping)
+        return;
+      if (entry.path().filename().string().starts_with(REMOVED_PREFIX))
+        std::filesystem::remove_all(entry.path(), error);
+    }
+
+    auto journal_path = run_journal_path(logs_directory);
+    if (!std::filesystem::exists(journal_path, error))
+      return;
+    std::vector<run_info> runs;
+    {
+      run_journal journal{journal_path};
+      for (auto const& record : journal.read_all())
+        if (record.kind == journal_record::type::FINISH)
+          runs.push_back(record.run);
+    }
+
+    // The journal is not locked while directories are removed, so other runs are not held up
+    std::unordered_set<std::string> removed;
+    for (auto const& directory : expired_runs(std::move(runs), policy, std::chrono::system_clock::now())) {
+      if (stopping)
+        break;
+      auto renamed = logs_directory / (REMOVED_PREFIX + directory);
+      std::filesystem::rename(logs_directory / directory, renamed, error);
+      if (error)
+        continue;
+      removed.insert(directory);
+      std::filesystem::remove_all(renamed, error);
+    }
+    if (removed.empty())
+      return;
+
+    run_journal journal{journal_path};
+    auto records = journal.read_all();
+    std::erase_if(records, [&](journal_record const& record) { return removed.contains(record.run.directory); });
+    journal.rewrite(records);
+    rebuild_index(journal);
+  } catch (std::exception const& e) {
+    std::cerr << "[log_retention] " << e.what() << "\n";
+  }
+}
@@ -1,55 +1,378 @@
+#include <csignal>
 #include <exception>
 #include <iostream>
 #include <string>
 
 #include "bpf_provider.hpp"
+#include "compressed_ostream.hpp"
 #include "console_logger.hpp"
+#include "fan_out.hpp"
+#include "jsonl_logger.hpp"
+#include "log_retention.hpp"
+#include "pipeline_stats.hpp"
+#include "replay_provider.hpp"
+#include "run_digests.hpp"
+#include "structure/chrome/chrome_structure_consumer.hpp"
+#include "structure/html/html_index.hpp"
 #include "structure/html/html_structure_consumer.hpp"
+#include "structure/plain/plain_structure_consumer.hpp"
 #include "structure/structure_provider.hpp"
+#include "tracing_daemon.hpp"
 
 std::string APP_NAME = "anteater";
 
-void html_version(int argc, char *argv[]) {
+struct options {
+  bool text = false;
+  // Html logs together with the other outputs, they are the default without any other
+  bool html_logs = false;
+  // Plain text logs written to the directory
+  std::optional<std::filesystem::path> plain;
+  // Keep the BPF programs loaded and serve clients instead of tracing a command
+  bool daemon = false;
+  bool connect = false;
+  std::filesystem::path socket = daemon_protocol::DEFAULT_SOCKET;
+  std::optional<std::filesystem::path> chrome_trace;
+  std::optional<std::filesystem::path> jsonl;
+  bpf_provider_options bpf;
+  html_options html;
+  structure_provider_options structure;
+  retention_policy retention;
+  // Running process traced instead of a command
+  std::optional<pid_t> attach;
+  // Recording replayed instead of tracing
+  std::optional<std::filesystem::path> replay;
+  // Runs of the html logs compared instead of tracing
+  std::optional<std::pair<std::string, std::string>> diff;
+  // Snapshots of the pipeline statistics are written to the file every interval
+  std::optional<std::filesystem::path> stats_file;
+  std::chrono::milliseconds stats_interval{1000};
+  std::unique_ptr<pipeline_stats> stats;
+  // Traced command, terminated by nullptr
+  char **command;
+
+  size_t outputs() const {
+    return html_logs + text + chrome_trace.has_value() + jsonl.has_value() + plain.has_value();
+  }
+};
+
+/**
+ * Options are accepted only before the traced command,
+ * everything after it belongs to the command itself.
+ */
+options parse_options(int argc, char *argv[]) {
+  options result;
+  int i = 1;
+  auto argument = [&](std::string const& option) {
+    if (++i >= argc)
+      throw std::runtime_error{"Option " + option + " expects an argument"};
+    return argv[i];
+  };
+
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    std::string arg{argv[i]};
+    if (arg == "--") {
+      i++;
+      break;
+    } else if (arg == "-L")
+      result.text = true;
+    else if (arg == "--html")
+      result.html_logs = true;
+    else if (arg == "--plain")
+      result.plain = argument(arg);
+    else if (arg == "--chrome-trace")
+      result.chrome_trace = argument(arg);
+    else if (arg == "--jsonl")
+      result.jsonl = argument(arg);
+    else if (arg == "--page-size") {
+      result.html.events_per_page = std::stoul(argument(arg));
+      if (result.html.events_per_page == 0)
+        throw std::runtime_error{"Page size must be positive"};
+    } else if (arg == "--sched-stats")
+      result.bpf.profile_scheduling = true;
+    else if (arg == "--coalesce")
+      result.bpf.coalesce_window = std::chrono::milliseconds{std::stoul(argument(arg))};
+    else if (arg == "--coalesce-limit")
+      result.bpf.coalesce_limit = std::stoul(argument(arg));
+    else if (arg == "--stage-writes")
+      result.bpf.stage_writes = true;
+    else if (arg == "--output-budget") {
+      // <head KB>[,<tail KB>], the tail is as large as the head by default
+      std::string budget = argument(arg);
+      size_t comma = budget.find(',');
+      size_t head = std::stoul(budget.substr(0, comma));
+      size_t tail = comma == std::string::npos ? head : std::stoul(budget.substr(comma + 1));
+      result.structure.output_limits = output_budget::limits{head * 1024, tail * 1024};
+    } else if (arg == "--keep-runs")
+      result.retention.max_runs = std::stoul(argument(arg));
+    else if (arg == "--keep-days")
+      result.retention.max_age = std::chrono::hours{24 * std::stoul(argument(arg))};
+    else if (arg == "--keep-mb")
+      result.retention.max_total_bytes = std::stoull(argument(arg)) * 1024 * 1024;
+    else if (arg == "--attach")
+      result.attach = std::stoi(argument(arg));
+    else if (arg == "--daemon")
+      result.daemon = true;
+    else if (arg == "--connect")
+      result.connect = true;
+    else if (arg == "--socket")
+      result.socket = argument(arg);
+    else if (arg == "--record")
+      result.bpf.record = argument(arg);
+    else if (arg == "--replay")
+      result.replay = argument(arg);
+    else if (arg == "--diff") {
+      std::string a = argument(arg);
+      result.diff = {a, argument(arg)};
+    } else if (arg == "--bpf-stats")
+      result.bpf.program_stats = true;
+    else if (arg == "--stats")
+      result.stats_file = argument(arg);
+    else if (arg == "--stats-interval")
+      result.stats_interval = std::chrono::milliseconds{std::stoul(argument(arg))};
+    else if (arg == "--compress")
+      result.html.compress = true;
+    else
+      throw std::runtime_error{"Unknown option " + arg};
+  }
+  if (result.connect)
+    result.bpf.daemon_socket = result.socket;
+  if (result.stats_file.has_value()) {
+    if (result.replay.has_value())
+      throw std::runtime_error{"--stats measures tracing and cannot be used with --replay"};
+    result.stats = std::make_unique<pipeline_stats>();
+    result.bpf.stats = result.stats.get();
+  }
+  if (result.daemon || result.attach.has_value() || result.replay.has_value() || result.diff.has_value())
+    return result;
+  if (i >= argc)
+    throw std::runtime_error{"Command expected"};
+  result.command = argv + i;
+  return result;
+}
+
+std::unique_ptr<events::event_provider> start(options const& opts) {
+  if (opts.replay.has_value()) {
+    // replaying needs no privileges, the recording is read as the user
+    if (syscall(SYS_setuid, getuid()))
+      throw std::runtime_error{"Cannot drop privileges"};
+    return std::make_unique<replay_provider>(trace_recording::load(opts.replay.value()));
+  }
+
+  auto provider = std::make_unique<bpf_provider>(opts.bpf);
+  if (opts.attach.has_value())
+    provider->attach(opts.attach.value());
+  else
+    provider->run(opts.command);
+  return provider;
+}
+
+// Started after dropping privileges, so that the statistics file belongs to the user
+std::unique_ptr<stats_reporter> report_stats(options const& opts) {
+  if (!opts.stats)
+    return nullptr;
+  return std::make_unique<stats_reporter>(*opts.stats, opts.stats_file.value(), opts.stats_interval);
+}
+
+std::filesystem::path html_logs_directory() {
   const std::filesystem::path home{getenv("HOME")};
-  const std::filesystem::path html_logs_directory = home / ".local/share" / APP_NAME / "logs/html";
-  structure_provider structure(std::make_unique<html_structure_consumer_root>(html_logs_directory));
+  return home / ".local/share" / APP_NAME / "logs/html";
+}
 
-  bpf_provider provider;
-  provider.run(argv + 1);
+std::unique_ptr<std::ostream> open_jsonl(std::filesystem::path const& path) {
+  auto file = open_output_file(path, path.extension() == ".gz");
+  if (!*file)
+    throw std::runtime_error{"Cannot open " + path.string()};
+  return file;
+}
+
+void html_version(options const& opts) {
+  const std::filesystem::path html_logs_directory = ::html_logs_directory();
+  basic_structure_provider<html_structure_consumer_root> structure(std::make_unique<html_structure_consumer_root>(html_logs_directory, opts.html), opts.structure);
+
+  auto provider = start(opts);
   //set uid only for current thread (breaking posix)
   syscall(SYS_setuid, getuid());
+  // started after dropping privileges, the thread inherits them
+  html_event_formatter index_fmt;
+  log_retention retention{html_logs_directory, opts.retention, [&](run_journal const& journal) {
+    html_index{html_logs_directory, index_fmt}.rebuild(journal);
+  }};
+  auto reporter = report_stats(opts);
 
   //busy waiting
-  while (provider.is_active()) {
-    auto v = provider.provide();
-    if (v.has_value())
+  while (provider->is_active()) {
+    auto v = provider->provide();
+    if (v.has_value()) {
       structure.consume(v.value());
+      if (opts.stats)
+        opts.stats->consumed(v.value());
+    }
   }
 }
 
-void text_version(int argc, char *argv[]) {
-  if(argc < 3)
-    throw std::runtime_error{"Command expected"};
-  bpf_provider provider;
+void text_version(options const& opts) {
+  auto provider = start(opts);
   console_logger logger;
-  provider.run(argv + 2);
 
   syscall(SYS_setuid, getuid());
+  auto reporter = report_stats(opts);
 
   //busy waiting
-  while (provider.is_active()) {
-    auto v = provider.provide();
-    if (v.has_value())
+  while (provider->is_active()) {
+    auto v = provider->provide();
+    if (v.has_value()) {
       logger.consume(v.value());
+      if (opts.stats)
+        opts.stats->consumed(v.value());
+    } else {
+      logger.flush();
+    }
   }
 }
 
+void chrome_version(options const& opts) {
+  auto provider = start(opts);
+
+  syscall(SYS_setuid, getuid());
+  // created after dropping privileges so that the trace belongs to the user
+  basic_structure_provider<chrome_structure_consumer_root> structure(std::make_unique<chrome_structure_consumer_root>(opts.chrome_trace.value()), opts.structure);
+  auto reporter = report_stats(opts);
+
+  //busy waiting
+  while (provider->is_active()) {
+    auto v = provider->provide();
+    if (v.has_value()) {
+      structure.consume(v.value());
+      if (opts.stats)
+        opts.stats->consumed(v.value());
+    }
+  }
+}
+
+void jsonl_version(options const& opts) {
+  auto provider = start(opts);
+
+  syscall(SYS_setuid, getuid());
+  auto file = open_jsonl(opts.jsonl.value());
+  jsonl_logger logger{*file};
+  auto reporter = report_stats(opts);
+
+  //busy waiting
+  while (provider->is_active()) {
+    auto v = provider->provide();
+    if (v.has_value()) {
+      logger.consume(v.value());
+      if (opts.stats)
+        opts.stats->consumed(v.value());
+    } else {
+      logger.flush();
+    }
+  }
+}
+
+// JSON lines output owning its file, for the fan-out
+struct jsonl_output {
+  std::unique_ptr<std::ostream> file;
+  jsonl_logger logger;
+
+  jsonl_output(std::filesystem::path const& path) : file(open_jsonl(path)), logger(*file) {}
+  void consume(events::event const& e) { logger.consume(e); }
+  void flush() { logger.flush(); }
+};
+
+// Every requested output runs on its own thread, the events are decoded only once
+void fan_out_version(options const& opts) {
+  auto provider = start(opts);
+
+  syscall(SYS_setuid, getuid());
+  // the outputs are created after dropping privileges, their threads inherit them
+  html_event_formatter index_fmt;
+  std::optional<log_retention> retention;
+  if (opts.html_logs)
+    retention.emplace(html_logs_directory(), opts.retention, [&](run_journal const& journal) {
+      html_index{html_logs_directory(), index_fmt}.rebuild(journal);
+    });
+  auto reporter = report_stats(opts);
+
+  fan_out outputs;
+  if (opts.html_logs)
+    outputs.add("html", [&] {
+      return std::make_unique<basic_structure_provider<html_structure_consumer_root>>(
+        std::make_unique<html_structure_consumer_root>(html_logs_directory(), opts.html), opts.structure);
+    });
+  if (opts.plain.has_value())
+    outputs.add("plain", [&] {
+      return std::make_unique<basic_structure_provider<plain_structure_consumer>>(
+        std::make_unique<plain_structure_consumer>(opts.plain.value(), opts.html.compress), opts.structure);
+    });
+  if (opts.chrome_trace.has_value())
+    outputs.add("chrome trace", [&] {
+      return std::make_unique<basic_structure_provider<chrome_structure_consumer_root>>(
+        std::make_unique<chrome_structure_consumer_root>(opts.chrome_trace.value()), opts.structure);
+    });
+  if (opts.jsonl.has_value())
+    outputs.add("jsonl", [&] { return std::make_unique<jsonl_output>(opts.jsonl.value()); });
+  if (opts.text)
+    outputs.add("console", [] { return std::make_unique<console_logger>(); });
+
+  //busy waiting
+  while (provider->is_active()) {
+    auto v = provider->provide();
+    if (v.has_value()) {
+      if (opts.stats)
+        opts.stats->consumed(v.value());
+      outputs.consume(std::move(v.value()));
+    }
+  }
+}
+
+// A run given by the path of its directory or by its name in the html logs
+std::filesystem::path run_directory(std::string const& run) {
+  if (std::filesystem::is_directory(run))
+    return run;
+  return html_logs_directory() / run;
+}
+
+// Like diff, 1 when some program changed
+int diff_version(options const& opts) {
+  // comparing runs needs no privileges, the paths are the user's
+  if (syscall(SYS_setuid, getuid()))
+    throw std::runtime_error{"Cannot drop privileges"};
+  auto const& [a, b] = opts.diff.value();
+  auto changes = run_digests::diff(
+    run_digests::load(run_directory(a) / run_digests::FILE_NAME),
+    run_digests::load(run_directory(b) / run_digests::FILE_NAME)
+  );
+  run_digests::print(std::cout, changes);
+  return changes.empty() ? 0 : 1;
+}
+
+static tracing_daemon *running_daemon = nullptr;
+
+void daemon_version(options const& opts) {
+  tracing_daemon daemon{opts.bpf, opts.socket};
+  running_daemon = &daemon;
+  auto stop = [](int) { running_daemon->stop(); };
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  daemon.run();
+}
+
 int main(int argc, char *argv[]) {
-  if(argc < 2)
-    throw std::runtime_error{"Command expected"};
-  if(std::string{argv[1]} == "-L")
-    text_version(argc, argv);
+  options opts = parse_options(argc, argv);
+  if(opts.diff.has_value())
+    return diff_version(opts);
+  if(opts.daemon)
+    daemon_version(opts);
+  else if(opts.outputs() > 1 || opts.plain.has_value())
+    fan_out_version(opts);
+  else if(opts.text)
+    text_version(opts);
+  else if(opts.chrome_trace.has_value())
+    chrome_version(opts);
+  else if(opts.jsonl.has_value())
+    jsonl_version(opts);
   else
-    html_version(argc, argv);
+    html_version(opts);
   return 0;
 }
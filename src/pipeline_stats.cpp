@@ -0,0 +1,156 @@
+#include "pipeline_stats.hpp"
+
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <variant>
+
+static const char *RECORD_NAMES[] = {"fork", "exit", "exec", "write"};
+
+size_t log_histogram::bucket(uint64_t value) {
+  if (value < (1 << SUB_BITS))
+    return value;
+  int exponent = 63 - __builtin_clzll(value);
+  size_t sub_bucket = (value >> (exponent - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+  return (static_cast<size_t>(exponent - SUB_BITS + 1) << SUB_BITS) + sub_bucket;
+}
+
+uint64_t log_histogram::highest(size_t bucket) {
+  if (bucket < (1 << SUB_BITS))
+    return bucket;
+  int exponent = (bucket >> SUB_BITS) + SUB_BITS - 1;
+  uint64_t sub_bucket = bucket & ((1 << SUB_BITS) - 1);
+  uint64_t lowest = ((1ull << SUB_BITS) + sub_bucket) << (exponent - SUB_BITS);
+  return lowest + (1ull << (exponent - SUB_BITS)) - 1;
+}
+
+log_histogram::summary log_histogram::summarize() const {
+  summary result;
+  result.count = total.load(std::memory_order_relaxed);
+  result.max = maximum.load(std::memory_order_relaxed);
+  if (result.count == 0)
+    return result;
+
+  std::pair<double, uint64_t *> percentiles[] = {
+    {0.5, &result.p50}, {0.9, &result.p90}, {0.99, &result.p99}, {0.999, &result.p999},
+  };
+  size_t next = 0;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKETS && next < std::size(percentiles); i++) {
+    seen += counts[i].load(std::memory_order_relaxed);
+    while (next < std::size(percentiles) && seen >= percentiles[next].first * result.count) {
+      // the bucket can hold values above the largest one recorded
+      *percentiles[next].second = std::min(highest(i), result.max);
+      next++;
+    }
+  }
+  return result;
+}
+
+void pipeline_stats::consumed(events::event const& e) {
+  auto timestamp = std::visit([](auto const& e) { return e.timestamp; }, e);
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  auto elapsed = std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec} - (timestamp - clock_origin);
+  latency.record(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+}
+
+pipeline_stats::counters pipeline_stats::current() const {
+  counters result;
+  for (size_t i = 0; i < RECORD_TYPES; i++) {
+    result.records[i] = records[i].load(std::memory_order_relaxed);
+    result.bytes[i] = bytes[i].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+static void write_json(std::ostream& os, log_histogram::summary const& s) {
+  os << "{\"count\": " << s.count << ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90
+     << ", \"p99\": " << s.p99 << ", \"p999\": " << s.p999 << ", \"max\": " << s.max << "}";
+}
+
+void pipeline_stats::write_json(std::ostream& os, counters const& previous, std::chrono::nanoseconds elapsed) const {
+  auto now = current();
+  double seconds = std::max(1e-9, std::chrono::duration<double>(elapsed).count());
+
+  os << std::fixed << std::setprecision(1) << "{\n  \"records\": {";
+  for (size_t i = 0; i < RECORD_TYPES; i++) {
+    os << (i > 0 ? "," : "") << "\n    \"" << RECORD_NAMES[i] << "\": {\"count\": " << now.records[i]
+       << ", \"bytes\": " << now.bytes[i]
+       << ", \"per_second\": " << (now.records[i] - previous.records[i]) / seconds
+       << ", \"bytes_per_second\": " << (now.bytes[i] - previous.bytes[i]) / seconds << "}";
+  }
+  os << "\n  },\n  \"dropped_events\": " << dropped.load(std::memory_order_relaxed);
+  os << ",\n  \"ring_occupancy_bytes\": ";
+  ::write_json(os, ring_occupancy.summarize());
+  os << ",\n  \"messages_depth\": ";
+  ::write_json(os, messages_depth.summarize());
+  os << ",\n  \"queue_depth\": ";
+  ::write_json(os, queue_depth.summarize());
+  os << ",\n  \"latency_ns\": ";
+  ::write_json(os, latency.summarize());
+  os << "\n}\n";
+}
+
+static void write_summary(std::ostream& os, char const *name, log_histogram::summary const& s) {
+  os << "  " << std::left << std::setw(22) << name << std::right
+     << " p50 " << s.p50 << "  p99 " << s.p99 << "  p99.9 " << s.p999 << "  max " << s.max << "\n";
+}
+
+void pipeline_stats::write_summary(std::ostream& os, std::chrono::nanoseconds elapsed) const {
+  auto now = current();
+  double seconds = std::max(1e-9, std::chrono::duration<double>(elapsed).count());
+
+  os << std::fixed << std::setprecision(1) << "[stats] " << seconds << " s\n";
+  for (size_t i = 0; i < RECORD_TYPES; i++)
+    os << "  " << std::left << std::setw(22) << RECORD_NAMES[i] << std::right
+       << ' ' << now.records[i] << " records, " << now.records[i] / seconds << "/s, "
+       << now.bytes[i] / seconds / (1 << 20) << " MiB/s\n";
+  os << "  " << std::left << std::setw(22) << "dropped" << std::right << ' ' << dropped.load(std::memory_order_relaxed) << "\n";
+  ::write_summary(os, "ring occupancy bytes", ring_occupancy.summarize());
+  ::write_summary(os, "messages depth", messages_depth.summarize());
+  ::write_summary(os, "queue depth", queue_depth.summarize());
+  ::write_summary(os, "latency ns", latency.summarize());
+}
+
+stats_reporter::stats_reporter(pipeline_stats const& stats, std::filesystem::path path, std::chrono::milliseconds interval)
+    : stats(stats), path(std::move(path)), interval(interval), worker(&stats_reporter::run, this) {}
+
+stats_reporter::~stats_reporter() {
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
+  }
+  wakeup.notify_one();
+  worker.join();
+  // the final snapshot covers the whole run
+  previous = {};
+  previous_time = start;
+  write_snapshot();
+  stats.write_summary(std::cerr, std::chrono::steady_clock::now() - start);
+}
+
+void stats_reporter::run() {
+  std::unique_lock lock{mutex};
+  while (!wakeup.wait_for(lock, interval, [this] { return stopping; }))
+    write_snapshot();
+}
+
+void stats_reporter::write_snapshot() {
+  auto now = std::chrono::steady_clock::now();
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream file{temporary};
+    stats.write_json(file, previous, now - previous_time);
+    if (!file) {
+      std::cerr << "[stats] Cannot write " << temporary << "\n";
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  previous = stats.current();
+  previous_time = now;
+}
@@ -0,0 +1,104 @@
+#include "process_tree.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+
+static std::optional<pid_t> parse_pid(std::string const& name) {
+  pid_t pid;
+  auto [end, error] = std::from_chars(name.data(), name.data() + name.size(), pid);
+  if (error != std::errc{} || end != name.data() + name.size())
+    return {};
+  return pid;
+}
+
+struct stat_fields {
+  char state;
+  pid_t parent;
+};
+
+static std::optional<stat_fields> read_stat(std::filesystem::path const& process) {
+  std::ifstream file{process / "stat"};
+  std::string stat{std::istreambuf_iterator<char>{file}, {}};
+  // the command in parentheses may contain anything, the parent follows the state after it
+  size_t end = stat.rfind(')');
+  if (end == std::string::npos)
+    return {};
+  stat_fields fields;
+  if (sscanf(stat.c_str() + end + 1, " %c %d", &fields.state, &fields.parent) != 2)
+    return {};
+  return fields;
+}
+
+static std::optional<pid_t> parent_of(std::filesystem::path const& process) {
+  auto fields = read_stat(process);
+  if (!fields.has_value())
+    return {};
+  return fields->parent;
+}
+
+bool process_exited(pid_t pid) {
+  // threads have their directory in /proc as well, they are removed as soon as they exit
+  auto fields = read_stat("/proc/" + std::to_string(pid));
+  return !fields.has_value() || fields->state == 'Z' || fields->state == 'X';
+}
+
+static uid_t real_uid(std::filesystem::path const& process) {
+  std::ifstream file{process / "status"};
+  std::string line;
+  while (std::getline(file, line))
+    if (line.starts_with("Uid:"))
+      return std::stoul(line.substr(4));
+  return 0;
+}
+
+static std::string command_line(std::filesystem::path const& process) {
+  std::ifstream file{process / "cmdline"};
+  std::string command{std::istreambuf_iterator<char>{file}, {}};
+  if (!command.empty() && command.back() == '\0')
+    command.pop_back();
+  std::replace(command.begin(), command.end(), '\0', ' ');
+  return command;
+}
+
+static process_snapshot read_process(pid_t pid, pid_t parent) {
+  std::filesystem::path process = "/proc/" + std::to_string(pid);
+  process_snapshot result{pid, parent, real_uid(process), command_line(process)};
+  std::error_code error;
+  result.working_directory = std::filesystem::read_symlink(process / "cwd", error).string();
+  for (auto const& entry : std::filesystem::directory_iterator(process / "task", error)) {
+    auto thread = parse_pid(entry.path().filename().string());
+    if (thread.has_value() && thread.value() != pid)
+      result.threads.push_back(thread.value());
+  }
+  return result;
+}
+
+std::vector<process_snapshot> read_process_tree(pid_t root) {
+  std::unordered_map<pid_t, std::vector<pid_t>> children;
+  std::error_code error;
+  for (auto const& entry : std::filesystem::directory_iterator("/proc", error)) {
+    auto pid = parse_pid(entry.path().filename().string());
+    if (!pid.has_value())
+      continue;
+    auto parent = parent_of(entry.path());
+    if (parent.has_value())
+      children[parent.value()].push_back(pid.value());
+  }
+
+  std::vector<process_snapshot> result;
+  auto root_parent = parent_of("/proc/" + std::to_string(root));
+  if (!root_parent.has_value())
+    return result;
+  result.push_back(read_process(root, root_parent.value()));
+  // breadth first, so parents come first
+  for (size_t i = 0; i < result.size(); i++)
+    for (pid_t child : children[result[i].pid])
+      result.push_back(read_process(child, result[i].pid));
+  return result;
+}
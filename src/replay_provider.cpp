@@ -0,0 +1,25 @@
+#include "replay_provider.hpp"
+
+#include <sys/types.h>
+
+#include <stdexcept>
+
+#include "backend/event.h"
+
+replay_provider::replay_provider(trace_recording recording)
+    : recording(std::move(recording)), decoder(this->recording.boot()) {}
+
+bool replay_provider::is_active() {
+  size_t next = offset, size;
+  return recording.next(next, size) != nullptr;
+}
+
+std::optional<events::event> replay_provider::provide() {
+  size_t size;
+  auto record = recording.next(offset, size);
+  if (record == nullptr)
+    return {};
+  if (!event_decoder::valid(record, size))
+    throw std::runtime_error{"The recording is corrupt"};
+  return decoder.decode(static_cast<backend::event const *>(record));
+}
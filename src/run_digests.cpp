@@ -0,0 +1,144 @@
+#include "run_digests.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+struct file_header {
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct record_header {
+  uint64_t digest;
+  int32_t exit_code;
+  uint32_t has_exit_code;
+  uint32_t command_size;
+  uint32_t directory_size;
+};
+}  // namespace
+
+static constexpr uint32_t MAGIC = 0x64696773;
+static constexpr uint32_t VERSION = 1;
+
+char const *const run_digests::FILE_NAME = "digests";
+
+void run_digests::save(std::filesystem::path const& path, std::vector<group_digest> const& digests) {
+  std::ofstream file{path, std::ios::binary};
+  file_header header{MAGIC, VERSION};
+  file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  for (auto const& d : digests) {
+    record_header record{
+      d.digest,
+      d.exit_code.value_or(0),
+      d.exit_code.has_value(),
+      static_cast<uint32_t>(d.command.size()),
+      static_cast<uint32_t>(d.working_directory.size()),
+    };
+    file.write(reinterpret_cast<char const *>(&record), sizeof(record));
+    file.write(d.command.data(), d.command.size());
+    file.write(d.working_directory.data(), d.working_directory.size());
+  }
+  if (!file)
+    throw std::runtime_error{"Cannot write " + path.string()};
+}
+
+std::vector<group_digest> run_digests::load(std::filesystem::path const& path) {
+  std::ifstream file{path, std::ios::binary};
+  file_header header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != MAGIC || header.version != VERSION)
+    throw std::runtime_error{path.string() + " is not a file of digests"};
+
+  // Sizes beyond the end of the file are not allocated
+  uint64_t remaining = std::filesystem::file_size(path) - sizeof(header);
+  std::vector<group_digest> result;
+  record_header record;
+  while (file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    remaining -= sizeof(record);
+    // a record cut short when the run was interrupted, or a corrupt one
+    if (uint64_t{record.command_size} + record.directory_size > remaining)
+      break;
+    remaining -= uint64_t{record.command_size} + record.directory_size;
+    group_digest d;
+    d.digest = record.digest;
+    if (record.has_exit_code)
+      d.exit_code = record.exit_code;
+    d.command.resize(record.command_size);
+    d.working_directory.resize(record.directory_size);
+    if (!file.read(d.command.data(), d.command.size()) || !file.read(d.working_directory.data(), d.working_directory.size()))
+      break;
+    result.push_back(std::move(d));
+  }
+  return result;
+}
+
+std::vector<changed_group> run_digests::diff(std::vector<group_digest> const& a, std::vector<group_digest> const& b) {
+  std::vector<changed_group> groups;
+  std::unordered_map<std::string, size_t> group_index;
+  auto group_of = [&](group_digest const& d) {
+    auto [entry, inserted] = group_index.try_emplace(d.command + '\0' + d.working_directory, groups.size());
+    if (inserted)
+      groups.push_back({d.command, d.working_directory});
+    return entry->second;
+  };
+
+  // The digest covers the command and directory, so it identifies the group as well
+  struct digest_entry {
+    size_t group;
+    // Programs of run a minus programs of run b with the digest
+    int64_t balance = 0;
+    std::optional<int> exit_code_a;
+    std::optional<int> exit_code_b;
+  };
+  std::unordered_map<uint64_t, digest_entry> digests;
+  digests.reserve(a.size() + b.size());
+
+  for (auto const& d : b) {
+    size_t group = group_of(d);
+    groups[group].count_b++;
+    auto& entry = digests.try_emplace(d.digest, digest_entry{group}).first->second;
+    entry.balance--;
+    entry.exit_code_b = d.exit_code;
+  }
+  for (auto const& d : a) {
+    size_t group = group_of(d);
+    groups[group].count_a++;
+    auto& entry = digests.try_emplace(d.digest, digest_entry{group}).first->second;
+    entry.balance++;
+    entry.exit_code_a = d.exit_code;
+  }
+
+  for (auto const& [digest, entry] : digests) {
+    if (entry.balance == 0)
+      continue;
+    auto& group = groups[entry.group];
+    group.changed += std::abs(entry.balance);
+    if (entry.balance > 0)
+      group.exit_code_a = entry.exit_code_a;
+    else
+      group.exit_code_b = entry.exit_code_b;
+  }
+
+  std::vector<changed_group> result;
+  for (auto& group : groups)
+    if (group.changed > 0)
+      result.push_back(std::move(group));
+  return result;
+}
+
+void run_digests::print(std::ostream& os, std::vector<changed_group> const& changes) {
+  for (auto const& c : changes) {
+    char const *kind = c.count_a == 0 ? "added" : c.count_b == 0 ? "removed" : "changed";
+    os << std::left << std::setw(8) << kind << std::right << c.working_directory << " $ " << c.command;
+    if (c.count_a > 1 || c.count_b > 1)
+      os << "  (" << c.changed << " of " << c.count_a + c.count_b << " runs differ)";
+    if (c.exit_code_a.has_value() && c.exit_code_b.has_value() && c.exit_code_a != c.exit_code_b)
+      os << "  exit " << c.exit_code_a.value() << " -> " << c.exit_code_b.value();
+    os << "\n";
+  }
+  if (changes.empty())
+    os << "No program changed\n";
+}
@@ -0,0 +1,179 @@
+#include "run_journal.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace events;
+
+namespace {
+// On-disk layout of a record, strings are truncated and zero-terminated
+struct raw_record {
+  uint32_t kind;
+  uint32_t has_exit_code;
+  uint64_t sequence;
+  int64_t start;
+  int64_t end;
+  uint64_t bytes;
+  int32_t exit_code;
+  uint32_t reserved;
+  char directory[80];
+  char link[160];
+  char command[224];
+};
+static_assert(sizeof(raw_record) == 512);
+}  // namespace
+
+static int64_t to_nanoseconds(time_point timestamp) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+}
+
+static time_point from_nanoseconds(int64_t nanoseconds) {
+  return time_point{std::chrono::duration_cast<time_point::duration>(std::chrono::nanoseconds{nanoseconds})};
+}
+
+template <size_t N>
+static void copy_string(char (&destination)[N], std::string const& source) {
+  size_t size = std::min(source.size(), N - 1);
+  std::memcpy(destination, source.data(), size);
+  destination[size] = '\0';
+}
+
+template <size_t N>
+static std::string read_string(char const (&source)[N]) {
+  return {source, strnlen(source, N)};
+}
+
+static raw_record encode(journal_record const& record) {
+  raw_record raw{};
+  raw.kind = static_cast<uint32_t>(record.kind);
+  raw.sequence = record.sequence;
+  raw.start = to_nanoseconds(record.run.start);
+  raw.end = to_nanoseconds(record.run.end);
+  raw.bytes = record.run.bytes;
+  raw.has_exit_code = record.run.exit_code.has_value();
+  raw.exit_code = record.run.exit_code.value_or(0);
+  copy_string(raw.directory, record.run.directory);
+  copy_string(raw.link, record.run.link);
+  copy_string(raw.command, record.run.command);
+  return raw;
+}
+
+static journal_record decode(raw_record const& raw) {
+  journal_record record{static_cast<journal_record::type>(raw.kind), raw.sequence};
+  record.run.directory = read_string(raw.directory);
+  record.run.link = read_string(raw.link);
+  record.run.command = read_string(raw.command);
+  record.run.start = from_nanoseconds(raw.start);
+  record.run.end = from_nanoseconds(raw.end);
+  record.run.bytes = raw.bytes;
+  if (raw.has_exit_code)
+    record.run.exit_code = raw.exit_code;
+  return record;
+}
+
+static void write_all(int fd, void const* data, size_t size) {
+  auto bytes = static_cast<char const*>(data);
+  while (size > 0) {
+    ssize_t written = write(fd, bytes, size);
+    if (written < 0)
+      throw std::runtime_error{"Failed to write the run journal"};
+    bytes += written;
+    size -= written;
+  }
+}
+
+std::filesystem::path run_journal_path(std::filesystem::path const& logs_directory) {
+  return logs_directory / "runs.journal";
+}
+
+run_journal::run_journal(std::filesystem::path const& path) : path(path) {
+  // The journal may be replaced by a compaction between open and flock, in which case
+  // the lock is taken on a file that is no longer in the directory
+  while (true) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+      throw std::runtime_error{"Failed to open the run journal " + path.string()};
+    if (flock(fd, LOCK_EX) != 0) {
+      close(fd);
+      throw std::runtime_error{"Failed to lock the run journal " + path.string()};
+    }
+    struct stat opened, current;
+    if (fstat(fd, &opened) == 0 && stat(path.c_str(), &current) == 0
+        && opened.st_dev == current.st_dev && opened.st_ino == current.st_ino)
+      return;
+    close(fd);
+  }
+}
+
+run_journal::~run_journal() {
+  // closing the descriptor releases the lock
+  close(fd);
+}
+
+size_t run_journal::size() const {
+  struct stat info;
+  if (fstat(fd, &info) != 0)
+    throw std::runtime_error{"Failed to read the run journal"};
+  // a record cut short by a crash is ignored
+  return info.st_size / sizeof(raw_record);
+}
+
+journal_record run_journal::read(size_t index) const {
+  raw_record raw;
+  if (pread(fd, &raw, sizeof(raw), index * sizeof(raw)) != sizeof(raw))
+    throw std::runtime_error{"Failed to read the run journal"};
+  return decode(raw);
+}
+
+std::vector<journal_record> run_journal::read_all() const {
+  std::vector<journal_record> result;
+  size_t count = size();
+  result.reserve(count);
+  for (size_t i = 0; i < count; i++)
+    result.push_back(read(i));
+  return result;
+}
+
+void run_journal::append(journal_record record) {
+  if (record.kind == journal_record::type::FINISH) {
+    record.sequence = 0;
+    read_backwards([&](journal_record const& previous) {
+      if (previous.kind != journal_record::type::FINISH)
+        return true;
+      record.sequence = previous.sequence + 1;
+      return false;
+    });
+  }
+  raw_record raw = encode(record);
+  write_all(fd, &raw, sizeof(raw));
+}
+
+void run_journal::rewrite(std::vector<journal_record> const& records) {
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+
+  int out = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (out < 0)
+    throw std::runtime_error{"Failed to create " + temporary.string()};
+  // the new journal is locked before it becomes visible
+  flock(out, LOCK_EX);
+  uint64_t sequence = 0;
+  for (auto record : records) {
+    if (record.kind == journal_record::type::FINISH)
+      record.sequence = sequence++;
+    raw_record raw = encode(record);
+    write_all(out, &raw, sizeof(raw));
+  }
+  fsync(out);
+  std::filesystem::rename(temporary, path);
+
+  close(fd);
+  fd = out;
+  // appends have to go to the end
+  fcntl(fd, F_SETFL, O_APPEND);
+}
@@ -0,0 +1,41 @@
+#include "string_pool.hpp"
+
+#include <cstring>
+
+using namespace events;
+
+static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+char* string_pool::allocate(size_t size) {
+  // long strings get a chunk of their own so that the current chunk is not wasted
+  if (size > CHUNK_SIZE / 4) {
+    chunks.push_back(std::make_unique<char[]>(size));
+    return chunks.back().get();
+  }
+  if (current_chunk == nullptr || current_chunk_used + size > CHUNK_SIZE) {
+    chunks.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+    current_chunk = chunks.back().get();
+    current_chunk_used = 0;
+  }
+  char* result = current_chunk + current_chunk_used;
+  current_chunk_used += size;
+  return result;
+}
+
+std::string_view string_pool::intern(std::string_view str) {
+  std::lock_guard lock{mutex};
+  auto it = strings.find(str);
+  if (it != strings.end())
+    return *it;
+
+  char* data = allocate(str.size());
+  std::memcpy(data, str.data(), str.size());
+  std::string_view interned{data, str.size()};
+  strings.insert(interned);
+  return interned;
+}
+
+string_pool& string_pool::global() {
+  static string_pool pool;
+  return pool;
+}
@@ -0,0 +1,132 @@
+#include "structure/chrome/chrome_structure_consumer.hpp"
+
+#include "compressed_ostream.hpp"
+
+using namespace events;
+
+// Trace event timestamps are in microseconds
+static void write_timestamp(json_writer& writer, time_point const& origin, time_point timestamp) {
+  writer.key("ts");
+  writer.fixed_point(std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp - origin).count(), 3);
+}
+
+static void write_track(json_writer& writer, pid_t pid) {
+  writer.key("pid");
+  writer.value(pid);
+  writer.key("tid");
+  writer.value(pid);
+}
+
+static std::unique_ptr<std::ostream> open_trace(std::filesystem::path const& path) {
+  std::filesystem::create_directories(path.parent_path());
+  // Perfetto opens gzip compressed traces directly
+  return open_output_file(path, path.extension() == ".gz");
+}
+
+chrome_structure_consumer_root::chrome_structure_consumer_root(std::filesystem::path path)
+    : file(open_trace(path)), writer(*file) {
+  std::cerr << "[chrome_structure_consumer_root] Saving trace to " << path.string() << "\n";
+
+  writer.begin_object();
+  writer.key("displayTimeUnit");
+  writer.value("ms");
+  writer.key("traceEvents");
+  writer.begin_array();
+}
+
+chrome_structure_consumer_root::~chrome_structure_consumer_root() {
+  writer.end_array();
+  writer.end_object();
+  writer.raw("\n");
+  writer.flush();
+}
+
+std::unique_ptr<structure_consumer> chrome_structure_consumer_root::consume(exec_event const& e) {
+  // The root sees another exec when the fork of a process was lost, the timestamps must not move
+  if (!origin.has_value())
+    origin = e.timestamp;
+  return std::make_unique<chrome_structure_consumer>(writer, origin.value(), e);
+}
+
+chrome_structure_consumer::chrome_structure_consumer(
+    json_writer& writer,
+    time_point const& origin,
+    exec_event const& source_event
+  ) : writer(writer), origin(origin), my_pid(source_event.source_pid) {
+  // Name the track after the latest program of the process
+  writer.begin_object();
+  writer.key("name");
+  writer.value("process_name");
+  writer.key("ph");
+  writer.value("M");
+  write_track(writer, my_pid);
+  writer.key("args");
+  writer.begin_object();
+  writer.key("name");
+  writer.value(source_event.command);
+  writer.end_object();
+  writer.end_object();
+
+  writer.begin_object();
+  writer.key("name");
+  writer.value(source_event.command);
+  writer.key("cat");
+  writer.value("exec");
+  writer.key("ph");
+  writer.value("B");
+  write_timestamp(writer, origin, source_event.timestamp);
+  write_track(writer, my_pid);
+  writer.key("args");
+  writer.begin_object();
+  writer.key("user");
+  writer.value(source_event.user_name);
+  writer.key("working_directory");
+  writer.value(source_event.working_directory);
+  writer.end_object();
+  writer.end_object();
+  writer.maybe_flush();
+}
+
+void chrome_structure_consumer::end_slice(time_point timestamp) {
+  if (ended) return;
+  ended = true;
+
+  writer.begin_object();
+  writer.key("ph");
+  writer.value("E");
+  write_timestamp(writer, origin, timestamp);
+  write_track(writer, my_pid);
+  writer.end_object();
+}
+
+std::unique_ptr<structure_consumer> chrome_structure_consumer::consume(exec_event const& e) {
+  // The program is replaced by the new one
+  if (e.source_pid == my_pid)
+    end_slice(e.timestamp);
+  return std::make_unique<chrome_structure_consumer>(writer, origin, e);
+}
+
+void chrome_structure_consumer::consume(exit_event const& e) {
+  if (e.source_pid != my_pid) return;
+  end_slice(e.timestamp);
+  writer.maybe_flush();
+}
+
+void chrome_structure_consumer::consume(write_event const& e) {
+  writer.begin_object();
+  writer.key("name");
+  writer.value(e.file_descriptor == write_event::descriptor::STDOUT ? "stdout" : "stderr");
+  writer.key("ph");
+  writer.value("i");
+  writer.key("s");
+  writer.value("t");
+  write_timestamp(writer, origin, e.timestamp);
+  write_track(writer, e.source_pid);
+  writer.key("args");
+  writer.begin_object();
+  writer.key("data");
+  writer.value(e.data);
+  writer.end_object();
+  writer.end_object();
+  writer.maybe_flush();
+}
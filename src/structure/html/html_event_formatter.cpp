@@ -1,5 +1,7 @@
 #include "structure/html/html_event_formatter.hpp"
 
+#include <algorithm>
+#include <iomanip>
 #include <regex>
 #include <sstream>
 
@@ -21,6 +23,22 @@ const std::string CSS = R"(
         a {
             color: lime;
         }
+        .timeline {
+            position: relative;
+        }
+        .bar {
+            position: absolute;
+            height: 12px;
+            min-width: 1px;
+            overflow: hidden;
+            white-space: nowrap;
+            font-size: 10px;
+            background: #2b4f72;
+            color: #fff;
+        }
+        .critical {
+            background: #c0392b;
+        }
     </style>
 )";
 
@@ -33,19 +51,28 @@ static auto round_to_millis(std::chrono::system_clock::time_point const& timesta
     return std::chrono::time_point_cast<std::chrono::milliseconds>(timestamp);
 }
 
-static void format_last_entry_timestamp(std::ostream& os) {
-    os <<
-        "<tr>" 
-            "<td> last entry timestamp </td>" 
-            "<td id='last-entry-timestamp'> ? </td>"
-        "</tr>"
-        "<script>"
-            "document.addEventListener('DOMContentLoaded', function() {"
-            "let timestamps = document.getElementsByClassName('timestamp');"
-            "if (timestamps.length != 0)"
-                "document.getElementById('last-entry-timestamp').textContent = timestamps[timestamps.length - 1].textContent" 
-        "});"
-        "</script>";
+static void format_duration(std::ostream& os, std::chrono::nanoseconds duration) {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    os << micros / 1000 << "." << std::setfill('0') << std::setw(3) << micros % 1000 << std::setfill(' ') << " ms";
+}
+
+static void format_size(std::ostream& os, size_t bytes) {
+    if (bytes >= 1024 * 1024)
+        os << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MB";
+    else if (bytes >= 1024)
+        os << std::fixed << std::setprecision(1) << bytes / 1024.0 << " KB";
+    else
+        os << bytes << " B";
+    os << std::defaultfloat;
+}
+
+static void format_last_entry_timestamp(std::ostream& os, std::optional<time_point> const& timestamp) {
+    os << "<tr><td> last entry timestamp </td><td>";
+    if (timestamp.has_value())
+        os << round_to_millis(timestamp.value());
+    else
+        os << "?";
+    os << "</td></tr>";
 }
 
 static void format_link_to_parent(
@@ -66,8 +93,13 @@ static void format_exec_info(std::ostream& os, exec_event const& e) {
     os << "<tr>" << "<td> exec timestamp </td>" << "<td>" << round_to_millis(e.timestamp) << "</td>" << "</tr>";
 }
 
-static void format_exit_code(std::ostream& os) {
-    os << "<tr> <td> exit code </td> <td id='exit_code'>?</td> </tr>";
+static void format_exit_code(std::ostream& os, std::optional<int> const& exit_code) {
+    os << "<tr><td> exit code </td><td>";
+    if (exit_code.has_value())
+        os << exit_code.value();
+    else
+        os << "?";
+    os << "</td></tr>";
 }
 
 static void format_return_links(
@@ -76,21 +108,21 @@ static void format_return_links(
 ) {
     os << "<tr><td> index </td> <td> <a href='" << root_info.index_path.string() << "'> index </a> </td></tr>";
     os << "<tr><td> root command </td> <td> <a href='" << root_info.root_command_path.string() << "'>" << root_info.root_command << "</a> </td></tr>";
+    os << "<tr><td> timeline </td> <td> <a href='" << root_info.timeline_path.string() << "'> timeline </a> </td></tr>";
 }
 
 static void format_page_header(
     std::ostream& os, 
-    exec_event const& source_event, 
-    root_path_info const& root_info,
-    std::optional<parent_path_info> const& parent_info
+    program_summary const& summary,
+    root_path_info const& root_info
 ) {
     os << TABLE_BEGIN;
 
     format_return_links(os, root_info); 
-    format_exec_info(os, source_event);
-    format_last_entry_timestamp(os);
-    format_exit_code(os);
-    format_link_to_parent(os, parent_info);
+    format_exec_info(os, summary.source_event);
+    format_last_entry_timestamp(os, summary.last_entry_timestamp);
+    format_exit_code(os, summary.exit_code);
+    format_link_to_parent(os, summary.parent_info);
 
     os << TABLE_END;
     os << HORIZONTAL_LINE;
@@ -111,40 +143,240 @@ static void begin_html(std::ostream& os) {
 
 static void begin_event_table(std::ostream& os) { os << "<table><tbody>"; }
 
-void html_event_formatter::begin_index(std::ostream& os) const {
+static void format_runs(std::ostream& os, std::string_view title, std::vector<run_info> const& runs) {
+    if (runs.empty())
+        return;
+    os << "<h3> " << title << " </h3>";
+    os << TABLE_BEGIN;
+    for (auto const& run : runs) {
+        os << "<tr class='event'>"
+            << "<td class='timestamp'>" << round_to_millis(run.start) << "</td>"
+            << "<td>";
+        if (run.end > run.start)
+            format_duration(os, run.end - run.start);
+        os << "</td><td>";
+        if (run.exit_code.has_value())
+            os << run.exit_code.value();
+        os << "</td><td>";
+        if (run.bytes > 0)
+            format_size(os, run.bytes);
+        os << "</td>"
+            << "<td> <a href='" << run.link << "'>" << run.command << "</a> </td>"
+            << "</tr>";
+    }
+    os << TABLE_END;
+}
+
+void html_event_formatter::format_index(std::ostream& os, index_page const& page) const {
     begin_html(os);
-    os << "<h2> index </h2>";
-    os << "<hr/>";
+    os << "<h2> " << page.title << " </h2>";
+    if (page.index_link.has_value())
+        os << "<a href='" << page.index_link.value() << "'> index </a>";
+    os << HORIZONTAL_LINE;
+
+    format_runs(os, "running", page.running);
+    format_runs(os, "failed", page.failed);
+    format_runs(os, "runs", page.runs);
+
+    if (!page.pages.empty() || page.legacy_index.has_value()) {
+        os << "<h3> older runs </h3>";
+        os << TABLE_BEGIN;
+        for (auto const& link : page.pages)
+            os << "<tr><td> <a href='" << link << "'>" << link << "</a> </td></tr>";
+        if (page.legacy_index.has_value())
+            os << "<tr><td> <a href='" << page.legacy_index.value() << "'> runs of older versions </a> </td></tr>";
+        os << TABLE_END;
+    }
+    os << "</body></html>";
+}
+
+static double timeline_percent(process_timeline const& timeline, events::time_point timestamp) {
+    auto total = timeline.last_timestamp() - timeline.first_timestamp();
+    if (total.count() == 0) return 0;
+    return 100.0 * (timestamp - timeline.first_timestamp()) / total;
+}
+
+void html_event_formatter::format_timeline(
+    std::ostream& os,
+    process_timeline const& timeline,
+    root_path_info const& root_info
+) const {
+    const size_t lane_height = 14;
+    auto const& nodes = timeline.nodes();
+
+    begin_html(os);
+    os << TABLE_BEGIN;
+    format_return_links(os, root_info);
+    os << "<tr><td> wall time </td><td>";
+    format_duration(os, timeline.last_timestamp() - timeline.first_timestamp());
+    os << "</td></tr>";
+    os << TABLE_END;
+    os << HORIZONTAL_LINE;
+
+    // The critical path is the part readable in lynx
+    os << "<h3> critical path </h3>";
+    os << TABLE_BEGIN;
+    for (auto id : timeline.critical_path()) {
+        auto const& n = nodes[id];
+        os << "<tr class='event'>"
+            << "<td class='timestamp'>" << round_to_millis(n.start) << "</td>"
+            << "<td>";
+        format_duration(os, n.end - n.start);
+        os << "</td>"
+            << "<td> <a href='./" << n.link << "'>" << n.command << "</a> </td>"
+            << "</tr>";
+    }
+    os << TABLE_END;
+    os << HORIZONTAL_LINE;
+
+    os << "<h3> timeline </h3>";
+    os << "<div class='timeline' style='height: " << timeline.lanes() * lane_height << "px;'>";
+    for (auto const& n : nodes) {
+        double left = timeline_percent(timeline, n.start);
+        double width = timeline_percent(timeline, n.end) - left;
+        os << "<a class='bar" << (n.critical ? " critical" : "") << "'"
+            << " href='./" << n.link << "'"
+            << " style='left: " << left << "%; width: " << width << "%; top: " << n.lane * lane_height << "px;'>"
+            << n.command
+            << "</a>";
+    }
+    os << "</div>";
+    os << "</body></html>";
+    os.flush();
+}
+
+
+static void format_sched_row(std::ostream& os, std::string const& name, std::chrono::nanoseconds duration) {
+    os << "<tr><td> " << name << " </td><td>";
+    format_duration(os, duration);
+    os << "</td></tr>";
+}
+
+static void format_runqueue_bucket(std::ostream& os, size_t bucket) {
+    // bucket i covers [2^i, 2^(i+1)) microseconds, the first and the last one are open
+    auto bound = [](size_t exponent) {
+        unsigned long micros = 1ul << exponent;
+        return micros < 1000 ? std::to_string(micros) + " us" : std::to_string(micros / 1000) + " ms";
+    };
+    if (bucket == 0)
+        os << "&lt; " << bound(1);
+    else if (bucket + 1 == events::runqueue_histogram_buckets)
+        os << "&gt;= " << bound(bucket);
+    else
+        os << bound(bucket) << " - " << bound(bucket + 1);
+}
+
+static void format_sched_summary(std::ostream& os, events::sched_stats const& stats, size_t processes) {
+    const size_t max_bar_width = 40;
+
+    os << "<h3> scheduling </h3>";
+    os << TABLE_BEGIN;
+    os << "<tr><td> processes </td><td>" << processes << "</td></tr>";
+    format_sched_row(os, "on-CPU time", stats.on_cpu);
+    format_sched_row(os, "off-CPU time", stats.off_cpu);
+    format_sched_row(os, "blocked time", stats.off_cpu - stats.runqueue);
+    format_sched_row(os, "runqueue latency", stats.runqueue);
+    os << TABLE_END;
+
+    uint32_t max_count = *std::max_element(stats.runqueue_histogram.begin(), stats.runqueue_histogram.end());
+    if (max_count == 0)
+        return;
+    os << "<h3> runqueue latency </h3>";
+    os << TABLE_BEGIN;
+    for (size_t i = 0; i < events::runqueue_histogram_buckets; i++) {
+        uint32_t count = stats.runqueue_histogram[i];
+        os << "<tr><td>";
+        format_runqueue_bucket(os, i);
+        os << "</td><td>" << count << "</td><td>"
+           << std::string((count * max_bar_width + max_count - 1) / max_count, '#')
+           << "</td></tr>";
+    }
+    os << TABLE_END;
+}
+
+static void format_pages(std::ostream& os, std::vector<page_info> const& pages) {
+    os << "<h3> output </h3>";
     os << TABLE_BEGIN;
+    for (size_t i = 0; i < pages.size(); i++) {
+        auto const& page = pages[i];
+        os << "<tr class='event'>"
+            << "<td class='timestamp'>" << round_to_millis(page.first_timestamp) << "</td>"
+            << "<td> <a href='./" << page.filename << "'> page " << i + 1 << "</a> </td>"
+            << "<td>" << page.events << " entries </td>"
+            << "</tr>";
+    }
+    os << TABLE_END;
 }
-void html_event_formatter::format_index_link(
+
+static void format_children(std::ostream& os, std::vector<child_info> const& children) {
+    if (children.empty())
+        return;
+    os << "<h3> executed programs </h3>";
+    os << TABLE_BEGIN;
+    for (auto const& child : children) {
+        os << "<tr><td> exit&nbsp;";
+        if (child.exit_code.has_value())
+            os << child.exit_code.value();
+        else
+            os << "?";
+        os << "</td><td> <a href='./" << child.filename << "'>" << child.command << "</a> </td></tr>";
+    }
+    os << TABLE_END;
+}
+
+void html_event_formatter::summary(
     std::ostream& os,
-    std::chrono::system_clock::time_point timestamp,
-    std::string const& href, 
-    std::string const& displayed_text
+    program_summary const& summary,
+    root_path_info const& root_info
 ) const {
-    os << "<tr>"
-        << "<td>" << round_to_millis(timestamp) << "</td>"
-        << "<td> <a href='" << href << "'>" << displayed_text << "</a> </td>"
-        << "</tr>";
+    begin_html(os);
+    format_page_header(os, summary, root_info);
+    format_pages(os, summary.pages);
+    format_children(os, summary.children);
+    if (summary.profiled_processes > 0)
+        format_sched_summary(os, summary.sched, summary.profiled_processes);
+    os << "</body></html>";
+    os.flush();
 }
 
-void html_event_formatter::begin(
-    std::ostream& os, 
-    events::exec_event const& source_event, 
-    root_path_info const& root_info,
-    std::optional<parent_path_info> const& parent_info
+static void format_page_navigation(
+    std::ostream& os,
+    std::string const& summary_filename,
+    std::optional<std::string> const& previous,
+    std::optional<std::string> const& next
+) {
+    os << TABLE_BEGIN << "<tr>";
+    os << "<td> <a href='./" << summary_filename << "'> summary </a> </td>";
+    if (previous.has_value())
+        os << "<td> <a href='./" << previous.value() << "'> previous page </a> </td>";
+    if (next.has_value())
+        os << "<td> <a href='./" << next.value() << "'> next page </a> </td>";
+    os << "</tr>" << TABLE_END;
+}
+
+void html_event_formatter::begin_page(
+    std::ostream& os,
+    std::string const& summary_filename,
+    std::string_view command,
+    size_t page_number,
+    std::optional<std::string> const& previous
 ) const {
     begin_html(os);
-    format_page_header(os, source_event, root_info, parent_info);
+    os << "<h3> " << command << " - page " << page_number << " </h3>";
+    format_page_navigation(os, summary_filename, previous, {});
+    os << HORIZONTAL_LINE;
     begin_event_table(os);
     os.flush();
 }
 
-static void end_html(std::ostream& os) { os << "</tbody></table></body></html>"; }
-
-void html_event_formatter::end(std::ostream& os) const {
-    end_html(os);
+void html_event_formatter::end_page(
+    std::ostream& os,
+    std::string const& summary_filename,
+    std::optional<std::string> const& next
+) const {
+    os << TABLE_END << HORIZONTAL_LINE;
+    format_page_navigation(os, summary_filename, {}, next);
+    os << "</body></html>";
     os.flush();
 }
 
@@ -157,16 +389,12 @@ void html_event_formatter::format(std::ostream& os, exit_event const& e) const {
         << "<td class='timestamp'>" << round_to_millis(e.timestamp) << "</td>"
         << "<td>" << "EXIT " << e.exit_code << "</td>"
         << "</tr>";
-
-    os << "<script>"
-        << "document.getElementById('exit_code').textContent = " << "'exit " << e.exit_code << "'"
-        << "</script>";
     os.flush();
 }
 
 void html_event_formatter::child_exit(std::ostream& os, exit_event const& e) const {
+    // Only emitted on the page holding the exec row of the child, so the element always exists
     os << "<script>"
-        << "if (document.getElementById('child_exit_code_" << e.source_pid << "'))"
         << "document.getElementById('child_exit_code_" << e.source_pid << "').innerHTML = " << "'exit&nbsp;" << e.exit_code << "&nbsp;'"
         << "</script>";
 }
@@ -216,3 +444,13 @@ void html_event_formatter::format(std::ostream& os, write_event const& e) const
     }
     os.flush();
 }
+
+void html_event_formatter::format(std::ostream& os, output_elided const& e) const {
+    os << "<tr class='event'>"
+        << "<td class='timestamp'>" << round_to_millis(e.timestamp) << "</td>"
+        << "<td><span style='color: #888;'>... ";
+    format_size(os, e.bytes);
+    os << " elided ...</span></td>"
+        << "</tr>";
+    os.flush();
+}
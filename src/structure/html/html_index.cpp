@@ -0,0 +1,117 @@
+#include "structure/html/html_index.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_set>
+
+static const std::string INDEX = "index.html";
+static const std::string LEGACY_INDEX = "index.legacy.html";
+// Records read from the end of the journal to find the running runs and the recent failures
+static constexpr size_t RECENT_RECORDS = 2 * html_index::RUNS_PER_PAGE;
+static constexpr size_t RECENT_FAILURES = 50;
+
+static std::string page_name(size_t number) {
+  return "index." + std::to_string(number) + ".html";
+}
+
+html_index::html_index(std::filesystem::path logs_directory, html_event_formatter const& fmt)
+    : logs_directory(std::move(logs_directory)), fmt(fmt) {}
+
+void html_index::keep_legacy_index(std::filesystem::path const& logs_directory) {
+  std::error_code error;
+  if (!std::filesystem::exists(run_journal_path(logs_directory), error)
+      && std::filesystem::exists(logs_directory / INDEX, error))
+    std::filesystem::rename(logs_directory / INDEX, logs_directory / LEGACY_INDEX, error);
+}
+
+void html_index::write_page(std::string const& name, index_page const& page) const {
+  // Readers never see a page which is written in the meantime
+  std::filesystem::path path = logs_directory / name;
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream file{temporary};
+    fmt.format_index(file, page);
+  }
+  std::filesystem::rename(temporary, path);
+}
+
+void html_index::write_full_page(size_t number, std::vector<run_info> const& runs) const {
+  index_page page;
+  page.title = "runs " + std::to_string(number * RUNS_PER_PAGE + 1) + " - " + std::to_string((number + 1) * RUNS_PER_PAGE);
+  page.index_link = INDEX;
+  for (auto const& run : runs)
+    (run.failed() ? page.failed : page.runs).push_back(run);
+  write_page(page_name(number), page);
+}
+
+void html_index::write_index(run_journal const& journal, bool seal) const {
+  std::optional<uint64_t> finished;
+  // Finished runs of the page being filled, or of the page filled by the last record when sealing
+  uint64_t first_sequence = 0;
+  bool full_page = false;
+  std::vector<run_info> page_runs;
+  index_page page;
+  page.title = "index";
+  std::unordered_set<std::string> finished_directories;
+  size_t records = 0;
+
+  journal.read_backwards([&](journal_record const& record) {
+    records++;
+    if (record.kind == journal_record::type::START) {
+      if (!finished_directories.contains(record.run.directory))
+        page.running.push_back(record.run);
+    } else {
+      if (!finished.has_value()) {
+        finished = record.sequence + 1;
+        full_page = seal && records == 1 && finished.value() % RUNS_PER_PAGE == 0;
+        first_sequence = full_page ? finished.value() - RUNS_PER_PAGE : finished.value() / RUNS_PER_PAGE * RUNS_PER_PAGE;
+      }
+      finished_directories.insert(record.run.directory);
+      if (record.sequence >= first_sequence)
+        page_runs.push_back(record.run);
+      if (record.run.failed() && page.failed.size() < RECENT_FAILURES)
+        page.failed.push_back(record.run);
+    }
+    bool page_complete = !finished.has_value() || page_runs.size() == finished.value() - first_sequence;
+    return records < RECENT_RECORDS || !page_complete;
+  });
+
+  size_t full_pages = finished.value_or(0) / RUNS_PER_PAGE;
+  if (full_page)
+    write_full_page(full_pages - 1, page_runs);
+  else
+    page.runs = std::move(page_runs);
+
+  for (size_t i = full_pages; i > 0; i--)
+    page.pages.push_back(page_name(i - 1));
+  std::error_code error;
+  if (std::filesystem::exists(logs_directory / LEGACY_INDEX, error))
+    page.legacy_index = LEGACY_INDEX;
+  write_page(INDEX, page);
+}
+
+void html_index::update(run_journal const& journal) const {
+  write_index(journal, true);
+}
+
+void html_index::rebuild(run_journal const& journal) const {
+  size_t number = 0;
+  std::vector<run_info> runs;
+  for (auto const& record : journal.read_all()) {
+    if (record.kind != journal_record::type::FINISH)
+      continue;
+    runs.push_back(record.run);
+    if (runs.size() == RUNS_PER_PAGE) {
+      // pages list the newest runs first
+      std::reverse(runs.begin(), runs.end());
+      write_full_page(number++, runs);
+      runs.clear();
+    }
+  }
+  // Pages left over from before the journal was compacted
+  std::error_code error;
+  while (std::filesystem::remove(logs_directory / page_name(number++), error))
+    ;
+  write_index(journal, false);
+}
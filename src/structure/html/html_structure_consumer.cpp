@@ -1,5 +1,8 @@
 #include "structure/html/html_structure_consumer.hpp"
 
+#include "compressed_ostream.hpp"
+#include "structure/html/html_index.hpp"
+
 #include <cstring>
 #include <iostream>
 #include <sstream>
@@ -21,7 +24,7 @@ static std::string normalize_string(std::string name) {
 }
 
 static std::string event_to_filename(events::exec_event const& e) {
-  std::string cmd = e.command;
+  std::string cmd{e.command};
   std::replace(cmd.begin(), cmd.end(), '/', '_');
   std::stringstream ss;
   ss << e.timestamp << " " << cmd;
@@ -31,88 +34,213 @@ static std::string event_to_filename(events::exec_event const& e) {
   return normalize_string(name);
 }
 
-static void update_index(
-  html_event_formatter const& fmt,
-  std::chrono::system_clock::time_point timestamp,
-  std::filesystem::path const& index_path, 
-  std::filesystem::path const& root_path, 
-  std::string const& command) {
-  if (!std::filesystem::exists(index_path)) {
-    std::filesystem::create_directories(index_path.parent_path());
-  }
-  if (!std::filesystem::exists(index_path)) {
-    std::ofstream file;
-    file.open(index_path);
-    fmt.begin_index(file);
-  }
-  std::ofstream file;
-  file.open(index_path, std::ios_base::app);
-
-  auto relative_path = std::filesystem::relative(root_path, index_path.parent_path());
-  fmt.format_index_link(file, timestamp, relative_path.string(), command);
-  file.close();
-}
-
-html_structure_consumer_root::html_structure_consumer_root(std::filesystem::path logs_directory) : logs_directory(logs_directory) {
+html_structure_consumer_root::html_structure_consumer_root(std::filesystem::path logs_directory, html_options options)
+  : options(options), logs_directory(logs_directory) {
   std::cerr << "[html_structure_consumer_root] Saving logs to " << logs_directory.string() << "\n";
 }
 
 std::unique_ptr<structure_consumer> html_structure_consumer_root::consume(events::exec_event const& e) {
   std::string filename = event_to_filename(e);
-  std::filesystem::path path = logs_directory / filename / (filename + ".html");
+  std::filesystem::path path = logs_directory / filename / (filename + options.extension());
+  run_directory = path.parent_path();
+  root_pid = e.source_pid;
+  run.directory = filename;
+  run.link = filename + "/" + path.filename().string();
+  run.command = e.command;
+  run.start = e.timestamp;
   root_info = {
-    e.command,
+    std::string{e.command},
     "./" + path.filename().string(),
-    "../index.html"
+    "../index.html",
+    "./timeline" + options.extension()
   };
-  update_index(fmt, e.timestamp, logs_directory / "index.html", path, e.command);
-  return std::make_unique<html_structure_consumer>(fmt, e, path, root_info);
+  record_run(journal_record::type::START);
+  return std::make_unique<html_structure_consumer>(fmt, options, e, path, root_info, timeline, digests, std::nullopt, std::nullopt);
 }
 
-html_structure_consumer::html_structure_consumer(
-    html_event_formatter const& fmt,
-    events::exec_event const& source_event, 
-    std::filesystem::path filename, 
-    root_path_info const& root_info
-  ) : fmt(fmt), filename(filename), my_pid(source_event.source_pid), command(source_event.command), root_info(root_info) {
-  std::filesystem::create_directories(filename.parent_path());
-  file.open(filename);
-  fmt.begin(file, source_event, root_info, {});
+void html_structure_consumer_root::consume(events::exit_event const& e) {
+  // The root receives the exit of the process which executed the traced command
+  if (e.source_pid == root_pid)
+    run.exit_code = e.exit_code;
+}
+
+html_structure_consumer_root::~html_structure_consumer_root() {
+  if (timeline.nodes().empty())
+    return;
+  timeline.finish();
+  {
+    auto file = open_output_file(run_directory / root_info.timeline_path, options.compress);
+    fmt.format_timeline(*file, timeline, root_info);
+  }
+  try {
+    run_digests::save(run_directory / run_digests::FILE_NAME, digests);
+  } catch (std::exception const& e) {
+    std::cerr << "[html_structure_consumer_root] " << e.what() << "\n";
+  }
+
+  // Recorded last, the run is complete once it is finished in the journal
+  if (options.compress)
+    compressed_ostream::wait_for_pending();
+  std::error_code error;
+  for (auto const& entry : std::filesystem::recursive_directory_iterator(run_directory, error))
+    if (entry.is_regular_file(error))
+      run.bytes += entry.file_size(error);
+  run.end = timeline.last_timestamp();
+  record_run(journal_record::type::FINISH);
+}
+
+void html_structure_consumer_root::record_run(journal_record::type kind) {
+  try {
+    std::filesystem::create_directories(logs_directory);
+    html_index::keep_legacy_index(logs_directory);
+    // The index is rendered while the journal is locked, so concurrent runs update it in turns
+    run_journal journal{run_journal_path(logs_directory)};
+    journal.append({kind, 0, run});
+    html_index{logs_directory, fmt}.update(journal);
+  } catch (std::exception const& e) {
+    std::cerr << "[html_structure_consumer_root] Failed to update the index: " << e.what() << "\n";
+  }
 }
 
 html_structure_consumer::html_structure_consumer(
     html_event_formatter const& fmt,
+    html_options const& options,
     events::exec_event const& source_event, 
     std::filesystem::path filename, 
     root_path_info const& root_info,
-    parent_path_info const& parent_info
-  ) : fmt(fmt), filename(filename), my_pid(source_event.source_pid), command(source_event.command), root_info(root_info) {
+    process_timeline& timeline,
+    std::vector<group_digest>& digests,
+    std::optional<parent_path_info> parent_info,
+    std::optional<process_timeline::node_id> parent_node
+  ) : fmt(fmt), options(options), filename(filename), my_pid(source_event.source_pid), command(source_event.command), root_info(root_info), timeline(timeline),
+      digests(digests),
+      lines([this](events::write_event const& e) { write_lines(e); }) {
+  node = timeline.begin(parent_node, source_event.timestamp, command, filename.filename().string());
+  summary.source_event = source_event;
+  summary.parent_info = std::move(parent_info);
   std::filesystem::create_directories(filename.parent_path());
-  file.open(filename);
-  fmt.begin(file, source_event, root_info, {parent_info});
+  write_summary();
+}
+
+std::string html_structure_consumer::page_filename(size_t page_number) const {
+  std::string name = filename.filename().string();
+  name.resize(name.size() - options.extension().size());
+  return name + "." + std::to_string(page_number) + options.extension();
+}
+
+void html_structure_consumer::write_summary() {
+  auto summary_file = open_output_file(filename, options.compress);
+  fmt.summary(*summary_file, summary, root_info);
+}
+
+void html_structure_consumer::reserve_entries(events::time_point timestamp, size_t entries) {
+  std::string summary_filename = filename.filename().string();
+  bool full = !summary.pages.empty() && summary.pages.back().events > 0
+    && summary.pages.back().events + entries > options.events_per_page;
+
+  // The page is closed when the program exits, descendants that outlive it start a new one
+  if (summary.pages.empty() || full || !file) {
+    std::string next = page_filename(current_page() + 1);
+    std::optional<std::string> previous;
+    if (!summary.pages.empty())
+      previous = summary.pages.back().filename;
+    if (file)
+      fmt.end_page(*file, summary_filename, next);
+    summary.pages.push_back({next, timestamp, timestamp, 0});
+    file = open_output_file(filename.parent_path() / next, options.compress);
+    fmt.begin_page(*file, summary_filename, command, current_page(), previous);
+    write_summary();
+  }
+
+  auto& page = summary.pages.back();
+  page.events += entries;
+  page.last_timestamp = timestamp;
+  summary.last_entry_timestamp = timestamp;
 }
 
 void html_structure_consumer::consume(events::fork_event const& e) {}
 
 std::unique_ptr<structure_consumer> html_structure_consumer::consume(events::exec_event const& e) {
-  std::filesystem::path childname = event_to_filename(e) + ".html";
-  fmt.format(file, e, childname);
+  // The program is replaced by the new one
+  if (e.source_pid == my_pid)
+    timeline.end(node, e.timestamp);
+  lines.flush(e.source_pid);
+
+  std::filesystem::path childname = event_to_filename(e) + options.extension();
+  reserve_entries(e.timestamp, 1);
+  fmt.format(*file, e, childname);
+  children[e.source_pid] = {summary.children.size(), current_page()};
+  summary.children.push_back({e.source_pid, std::string{e.command}, childname.string(), std::nullopt});
 
   std::filesystem::path subfilename = filename.parent_path() / childname;
   parent_path_info parent_info{this->filename.filename(), this->command};
-  return std::make_unique<html_structure_consumer>(fmt, e, subfilename, root_info, parent_info);
+  return std::make_unique<html_structure_consumer>(fmt, options, e, subfilename, root_info, timeline, digests, parent_info, node);
 }
 
 void html_structure_consumer::consume(events::exit_event const& e) {
-  if (e.source_pid == my_pid)
-    fmt.format(file, e);
-  fmt.child_exit(file, e);
+  lines.flush(e.source_pid);
+  digest.exit(e.source_pid);
+  if (e.source_pid == my_pid) {
+    reserve_entries(e.timestamp, 1);
+    fmt.format(*file, e);
+    timeline.end(node, e.timestamp);
+    summary.exit_code = e.exit_code;
+  }
+
+  auto child = children.find(e.source_pid);
+  if (child != children.end()) {
+    summary.children[child->second.index].exit_code = e.exit_code;
+    if (file && child->second.page == current_page())
+      fmt.child_exit(*file, e);
+    else if (!file)
+      write_summary();
+  }
+
+  if (e.source_pid == my_pid) {
+    // The group lives until the end of the run, its page and its compression state do not
+    fmt.end_page(*file, filename.filename().string(), std::nullopt);
+    file.reset();
+    write_summary();
+  }
 }
 
 void html_structure_consumer::consume(events::write_event const& e) {
-  fmt.format(file, e);
+  digest.write(e);
+  lines.write(e);
+}
+
+void html_structure_consumer::write_lines(events::write_event const& e) {
+  // Every line of the output is a separate row, a final newline does not start another one
+  size_t lines = std::count(e.data.begin(), e.data.end(), '\n');
+  if (!e.data.empty() && e.data.back() != '\n')
+    lines++;
+  reserve_entries(e.timestamp, lines);
+  fmt.format(*file, e);
+}
+
+void html_structure_consumer::consume(output_elided const& e) {
+  // Unfinished lines of the head come before the marker
+  lines.flush_all();
+  digest.elide(e.bytes);
+  reserve_entries(e.timestamp, 1);
+  fmt.format(*file, e);
+}
+
+void html_structure_consumer::consume(events::sched_stats const& stats) {
+  summary.sched += stats;
+  summary.profiled_processes++;
 }
 
 html_structure_consumer::~html_structure_consumer() {
-  fmt.end(file);
+  lines.flush_all();
+  if (file)
+    fmt.end_page(*file, filename.filename().string(), std::nullopt);
+  write_summary();
+  auto const& program = summary.source_event;
+  digests.push_back({
+    std::string{program.command},
+    std::string{program.working_directory},
+    summary.exit_code,
+    digest.digest(program, summary.exit_code),
+  });
 }
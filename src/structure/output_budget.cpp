@@ -0,0 +1,43 @@
+#include "structure/output_budget.hpp"
+
+using namespace events;
+
+output_budget::output_budget(limits l) : l(l) {}
+
+size_t output_budget::admit(write_event const& e) {
+  size_t head_part = std::min(e.data.size(), l.head - head_used);
+  head_used += head_part;
+  if (head_part == e.data.size())
+    return head_part;
+
+  write_event rest{e};
+  rest.data.erase(0, head_part);
+  tail_size += rest.data.size();
+  tail.push_back(std::move(rest));
+
+  // Drop the oldest bytes, the write on the boundary loses its beginning
+  while (tail_size > l.tail) {
+    write_event& oldest = tail.front();
+    size_t excess = tail_size - l.tail;
+    if (!elided.has_value())
+      elided = output_elided{oldest.timestamp, 0};
+    size_t dropped = std::min(excess, oldest.data.size());
+    elided->bytes += dropped;
+    tail_size -= dropped;
+    if (dropped == oldest.data.size())
+      tail.pop_front();
+    else
+      oldest.data.erase(0, dropped);
+  }
+  return head_part;
+}
+
+std::optional<output_budget::retained> output_budget::take() {
+  if (tail.empty() && !elided.has_value())
+    return {};
+  retained result{elided.value_or(output_elided{tail.front().timestamp, 0}), std::move(tail)};
+  tail.clear();
+  tail_size = 0;
+  elided.reset();
+  return result;
+}
@@ -1,44 +1,172 @@
 #include "structure/plain/plain_event_formatter.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
 using namespace events;
 
-std::string unescape(std::string const& s) {
-  std::string result;
-  for (char c : s) {
-    if (c == '\n')
-      result += "\\n";
-    else if (c == 0)
-      result += " ";
-    else
-      result.push_back(c);
+// Blocks written to the stream are about this large
+static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+void plain_event_formatter::append_number(int64_t number) {
+  char digits[24];
+  auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), number);
+  buffer.append(digits, end);
+}
+
+void plain_event_formatter::append_padded(std::string_view str, size_t width) {
+  if (str.size() < width)
+    buffer.append(width - str.size(), ' ');
+  buffer.append(str);
+}
+
+static void write_digits(char* out, unsigned value, int count) {
+  for (int i = count - 1; i >= 0; i--) {
+    out[i] = '0' + value % 10;
+    value /= 10;
+  }
+}
+
+// Same as `os << std::setw(30) << timestamp`, i.e. " YYYY-MM-DD HH:MM:SS.nnnnnnnnn" in UTC
+void plain_event_formatter::append_timestamp(time_point timestamp) {
+  using namespace std::chrono;
+  auto nanos = time_point_cast<nanoseconds>(timestamp);
+  auto second = floor<seconds>(nanos);
+
+  if (second.time_since_epoch().count() != cached_second) {
+    auto day = floor<days>(second);
+    year_month_day date{day};
+    hh_mm_ss time{second - day};
+
+    write_digits(cached_prefix, static_cast<int>(date.year()), 4);
+    cached_prefix[4] = '-';
+    write_digits(cached_prefix + 5, static_cast<unsigned>(date.month()), 2);
+    cached_prefix[7] = '-';
+    write_digits(cached_prefix + 8, static_cast<unsigned>(date.day()), 2);
+    cached_prefix[10] = ' ';
+    write_digits(cached_prefix + 11, time.hours().count(), 2);
+    cached_prefix[13] = ':';
+    write_digits(cached_prefix + 14, time.minutes().count(), 2);
+    cached_prefix[16] = ':';
+    write_digits(cached_prefix + 17, time.seconds().count(), 2);
+    cached_second = second.time_since_epoch().count();
   }
-  return result;
+
+  char fraction[10];
+  fraction[0] = '.';
+  write_digits(fraction + 1, (nanos - second).count(), 9);
+
+  buffer.push_back(' ');
+  buffer.append(cached_prefix, sizeof(cached_prefix));
+  buffer.append(fraction, sizeof(fraction));
+}
+
+void plain_event_formatter::append_header(event_base const& e, std::string_view name) {
+  append_timestamp(e.timestamp);
+  char pid[24];
+  auto [end, ec] = std::to_chars(pid, pid + sizeof(pid), e.source_pid);
+  append_padded({pid, end}, 8);
+  append_padded(name, 6);
+}
+
+static const char* find(const char* begin, const char* end, char c) {
+  auto found = static_cast<const char*>(std::memchr(begin, c, end - begin));
+  return found == nullptr ? end : found;
+}
+
+// Escapes newlines and replaces null bytes with spaces.
+// memchr is vectorized, so plain runs of characters are found and copied in bulk.
+void plain_event_formatter::append_unescaped(std::string_view str) {
+  const char* begin = str.data();
+  const char* end = begin + str.size();
+  const char* newline = find(begin, end, '\n');
+  const char* null = find(begin, end, '\0');
+
+  while (true) {
+    const char* next = std::min(newline, null);
+    buffer.append(begin, next);
+    if (next == end) break;
+    if (next == newline) {
+      buffer.append("\\n");
+      newline = find(next + 1, end, '\n');
+    } else {
+      buffer.push_back(' ');
+      null = find(next + 1, end, '\0');
+    }
+    begin = next + 1;
+  }
+}
+
+void plain_event_formatter::maybe_flush(std::ostream& os) {
+  if (buffer.size() >= FLUSH_THRESHOLD)
+    flush(os);
+}
+
+void plain_event_formatter::flush(std::ostream& os) {
+  if (buffer.empty()) return;
+  os.write(buffer.data(), buffer.size());
+  os.flush();
+  buffer.clear();
+}
+
+void plain_event_formatter::release(std::ostream& os) {
+  flush(os);
+  std::string{}.swap(buffer);
 }
 
 void plain_event_formatter::format(std::ostream& os, fork_event const& e) {
-  os << std::setw(30) << e.timestamp << std::setw(8) << e.source_pid
-     << std::setw(6) << "FORK" << std::setw(8) << e.child_pid << "\n";
+  append_header(e, "FORK");
+  char pid[24];
+  auto [end, ec] = std::to_chars(pid, pid + sizeof(pid), e.child_pid);
+  append_padded({pid, end}, 8);
+  buffer.push_back('\n');
+  maybe_flush(os);
 }
+
 void plain_event_formatter::format(std::ostream& os, exit_event const& e) {
-  os << std::setw(30) << e.timestamp << std::setw(8) << e.source_pid
-     << std::setw(6) << "EXIT"
-     << " " << e.exit_code << "\n";
+  append_header(e, "EXIT");
+  buffer.push_back(' ');
+  append_number(e.exit_code);
+  if (e.sched.has_value()) {
+    using std::chrono::microseconds, std::chrono::duration_cast;
+    buffer.append(" on-cpu ");
+    append_number(duration_cast<microseconds>(e.sched->on_cpu).count());
+    buffer.append("us off-cpu ");
+    append_number(duration_cast<microseconds>(e.sched->off_cpu).count());
+    buffer.append("us runqueue ");
+    append_number(duration_cast<microseconds>(e.sched->runqueue).count());
+    buffer.append("us");
+  }
+  buffer.push_back('\n');
+  maybe_flush(os);
 }
+
 void plain_event_formatter::format(std::ostream& os, exec_event const& e) {
-  os << std::setw(30) << e.timestamp << std::setw(8) << e.source_pid
-     << std::setw(6) << "EXEC" << std::setw(8) << e.user_id << " "
-     << unescape(e.command) << "\n";
+  append_header(e, "EXEC");
+  char uid[24];
+  auto [end, ec] = std::to_chars(uid, uid + sizeof(uid), e.user_id);
+  append_padded({uid, end}, 8);
+  buffer.push_back(' ');
+  append_unescaped(e.command);
+  buffer.push_back('\n');
+  maybe_flush(os);
 }
 
-std::string descriptor_name(write_event::descriptor fd) {
+static std::string_view descriptor_name(write_event::descriptor fd) {
   switch (fd) {
     case write_event::descriptor::STDOUT: return "STDOUT";
     case write_event::descriptor::STDERR: return "STDERR";
   }
+  return "";
 }
 
 void plain_event_formatter::format(std::ostream& os, write_event const& e) {
-  os << std::setw(30) << e.timestamp << std::setw(8) << e.source_pid
-     << std::setw(6) << "WRITE" << " " << descriptor_name(e.file_descriptor) << " "
-     << unescape(e.data) << "\n";
-}
\ No newline at end of file
+  append_header(e, "WRITE");
+  buffer.push_back(' ');
+  buffer.append(descriptor_name(e.file_descriptor));
+  buffer.push_back(' ');
+  append_unescaped(e.data);
+  buffer.push_back('\n');
+  maybe_flush(os);
+}
@@ -1,44 +1,69 @@
 #include "structure/plain/plain_structure_consumer.hpp"
 
+#include "compressed_ostream.hpp"
+
 #include <cstring>
 #include <iostream>
 #include <sstream>
 #include <algorithm>
 
-std::string event_to_filename(events::exec_event const& e) {
-  std::string cmd = e.command;
+static std::string event_to_filename(events::exec_event const& e) {
+  std::string cmd{e.command};
   std::replace(cmd.begin(), cmd.end(), '/', '_');
   std::stringstream ss;
   ss << e.timestamp << " " << cmd;
   return ss.str();
 }
 
-plain_structure_consumer::plain_structure_consumer(std::filesystem::path logs_directory) : logs_directory(logs_directory) {}
+static std::string extension(bool compress) { return compress ? ".txt.gz" : ".txt"; }
+
+plain_structure_consumer::plain_structure_consumer(std::filesystem::path logs_directory, bool compress)
+    : logs_directory(logs_directory), compress(compress) {}
 
 std::unique_ptr<structure_consumer> plain_structure_consumer::consume(events::exec_event const& e) {
   std::string filename = event_to_filename(e);
-  std::filesystem::path path = logs_directory / filename / (filename + ".txt");
-  return std::make_unique<subconsumer>(path);
+  std::filesystem::path path = logs_directory / filename / (filename + extension(compress));
+  return std::make_unique<subconsumer>(path, compress, e.source_pid);
 }
 
-plain_structure_consumer::subconsumer::subconsumer(std::filesystem::path filename)
-    : filename(filename) {
+plain_structure_consumer::subconsumer::subconsumer(std::filesystem::path filename, bool compress, pid_t pid)
+    : filename(filename), compress(compress), my_pid(pid), lines([this](events::write_event const& e) { fmt.format(output(), e); }) {
   std::filesystem::create_directories(filename.parent_path());
-  file.open(filename);
+  file = open_output_file(filename, compress);
+}
+
+plain_structure_consumer::subconsumer::~subconsumer() {
+  lines.flush_all();
+  if (file)
+    fmt.flush(*file);
+}
+
+std::ostream& plain_structure_consumer::subconsumer::output() {
+  // Descendants which outlive the program append to its log
+  if (!file)
+    file = open_output_file(filename, compress, true);
+  return *file;
 }
 
 void plain_structure_consumer::subconsumer::consume(events::fork_event const& e) {
-  fmt.format(file, e);
+  fmt.format(output(), e);
 }
 std::unique_ptr<structure_consumer> plain_structure_consumer::subconsumer::consume(events::exec_event const& e) {
-  fmt.format(file, e);
+  lines.flush(e.source_pid);
+  fmt.format(output(), e);
 
-  std::filesystem::path subfilename = filename.parent_path() / (event_to_filename(e) + ".txt");
-  return std::make_unique<plain_structure_consumer::subconsumer>(subfilename);
+  std::filesystem::path subfilename = filename.parent_path() / (event_to_filename(e) + extension(compress));
+  return std::make_unique<plain_structure_consumer::subconsumer>(subfilename, compress, e.source_pid);
 }
 void plain_structure_consumer::subconsumer::consume(events::exit_event const& e) {
-  fmt.format(file, e);
+  lines.flush(e.source_pid);
+  fmt.format(output(), e);
+  // The group lives until the end of the run, its buffer and file are released when the program exits
+  if (e.source_pid == my_pid) {
+    fmt.release(*file);
+    file.reset();
+  }
 }
 void plain_structure_consumer::subconsumer::consume(events::write_event const& e) {
-  fmt.format(file, e);
+  lines.write(e);
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "structure/process_timeline.hpp"
+
+#include <stack>
+
+std::optional<process_timeline::node_id>& process_timeline::last_finished_child(std::optional<node_id> parent) {
+  if (parent.has_value())
+    return all_nodes[parent.value()].last_finished_child;
+  return last_finished_root;
+}
+
+void process_timeline::update_bounds(events::time_point timestamp) {
+  first = std::min(first, timestamp);
+  last = std::max(last, timestamp);
+}
+
+process_timeline::node_id process_timeline::begin(
+    std::optional<node_id> parent,
+    events::time_point start,
+    std::string command,
+    std::string link) {
+  update_bounds(start);
+
+  size_t lane;
+  if (free_lanes.empty()) {
+    lane = lane_count++;
+  } else {
+    lane = free_lanes.back();
+    free_lanes.pop_back();
+  }
+
+  node n{
+    .command = std::move(command),
+    .link = std::move(link),
+    .start = start,
+    .end = start,
+    .lane = lane,
+    .parent = parent,
+    .predecessor = last_finished_child(parent),
+  };
+  all_nodes.push_back(std::move(n));
+  return all_nodes.size() - 1;
+}
+
+void process_timeline::end(node_id id, events::time_point timestamp) {
+  node& n = all_nodes[id];
+  if (n.ended) return;
+  update_bounds(timestamp);
+
+  n.ended = true;
+  n.end = timestamp;
+  free_lanes.push_back(n.lane);
+  last_finished_child(n.parent) = id;
+}
+
+void process_timeline::finish() {
+  for (node_id id = 0; id < all_nodes.size(); id++)
+    end(id, last);
+
+  // Every program is pushed at most once, either as the last finished
+  // child of its parent or as the predecessor of its sibling
+  std::stack<node_id> pending;
+  if (last_finished_root.has_value())
+    pending.push(last_finished_root.value());
+  while (!pending.empty()) {
+    node& n = all_nodes[pending.top()];
+    pending.pop();
+    n.critical = true;
+    if (n.predecessor.has_value())
+      pending.push(n.predecessor.value());
+    if (n.last_finished_child.has_value())
+      pending.push(n.last_finished_child.value());
+  }
+}
+
+std::vector<process_timeline::node_id> process_timeline::critical_path() const {
+  // Programs are stored in the order they started
+  std::vector<node_id> result;
+  for (node_id id = 0; id < all_nodes.size(); id++)
+    if (all_nodes[id].critical) result.push_back(id);
+  return result;
+}
@@ -0,0 +1,114 @@
+#include "synthetic_trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "backend/event.h"
+
+static const pid_t ROOT_PID = 1000;
+
+synthetic_trace::synthetic_trace() : recording(events::time_point{}) {}
+
+uint64_t synthetic_trace::tick() {
+  return clock += 1000;
+}
+
+synthetic_trace& synthetic_trace::fork(pid_t parent, pid_t child) {
+  backend::fork_event e{backend::FORK, 1, tick(), parent, child};
+  recording.append(&e, sizeof(e));
+  return *this;
+}
+
+synthetic_trace& synthetic_trace::exec(pid_t pid, std::string_view command, std::string_view working_directory) {
+  auto directory = directories.find(working_directory);
+  bool cached = directory != directories.end();
+  if (!cached)
+    directory = directories.emplace(working_directory, directories.size() + 1).first;
+  size_t path_size = cached ? 0 : working_directory.size();
+
+  std::vector<char> buffer(sizeof(backend::exec_event) + command.size() + path_size);
+  auto e = reinterpret_cast<backend::exec_event *>(buffer.data());
+  *e = {backend::EXEC, 1, tick(), pid, 1000, static_cast<int>(command.size()), static_cast<int>(path_size), cached};
+  e->working_directory_key.dentry = directory->second;
+  std::memcpy(e->data, command.data(), command.size());
+  std::memcpy(e->data + command.size(), working_directory.data(), path_size);
+  // arguments are separated by zeros
+  std::replace(e->data, e->data + command.size(), ' ', '\0');
+  recording.append(buffer.data(), buffer.size());
+  return *this;
+}
+
+synthetic_trace& synthetic_trace::write(pid_t pid, events::write_event::descriptor fd, std::string_view data) {
+  std::vector<char> buffer(sizeof(backend::write_event) + data.size());
+  auto e = reinterpret_cast<backend::write_event *>(buffer.data());
+  auto descriptor = fd == events::write_event::descriptor::STDOUT ? backend::STDOUT : backend::STDERR;
+  *e = {backend::WRITE, 1, tick(), descriptor, pid, static_cast<int>(data.size())};
+  std::memcpy(e->data, data.data(), data.size());
+  recording.append(buffer.data(), buffer.size());
+  return *this;
+}
+
+synthetic_trace& synthetic_trace::exit(pid_t pid, int code) {
+  backend::exit_event e{backend::EXIT, 1, tick(), pid, code};
+  recording.append(&e, sizeof(e));
+  return *this;
+}
+
+namespace workloads {
+trace_recording fork_storm(size_t processes) {
+  synthetic_trace trace;
+  trace.exec(ROOT_PID, "make -j8");
+  for (size_t i = 1; i <= processes; i++) {
+    pid_t child = ROOT_PID + i;
+    trace.fork(ROOT_PID, child)
+      .write(child, events::write_event::descriptor::STDOUT, "worker " + std::to_string(i) + " done\n")
+      .exit(child);
+  }
+  trace.exit(ROOT_PID);
+  return trace.result();
+}
+
+trace_recording exec_chain(size_t depth) {
+  synthetic_trace trace;
+  trace.exec(ROOT_PID, "sh -c make");
+  for (size_t i = 1; i < depth; i++) {
+    pid_t pid = ROOT_PID + i;
+    trace.fork(pid - 1, pid).exec(pid, "sh -c make level " + std::to_string(i));
+  }
+  pid_t deepest = ROOT_PID + depth - 1;
+  trace.write(deepest, events::write_event::descriptor::STDOUT, "deepest level\n");
+  for (pid_t pid = deepest; pid >= ROOT_PID; pid--)
+    trace.exit(pid);
+  return trace.result();
+}
+
+trace_recording write_flood(write_flood_options const& options) {
+  synthetic_trace trace;
+  trace.exec(ROOT_PID, "make -j8");
+  for (size_t i = 1; i < options.processes; i++)
+    trace.fork(ROOT_PID, ROOT_PID + i).exec(ROOT_PID + i, "cc -c file" + std::to_string(i) + ".c");
+
+  std::string line(options.line_length > 0 ? options.line_length - 1 : 0, 'a');
+  line.push_back('\n');
+  std::string redraw = "\x1B[32m" + line.substr(0, line.size() / 2) + "\x1B[0m\r";
+
+  // the fraction of redraws is kept exact without randomness, so results are comparable
+  double redraws = 0;
+  for (size_t i = 0; i < options.writes; i++) {
+    pid_t pid = ROOT_PID + i % options.processes;
+    redraws += options.ansi_density;
+    if (redraws >= 1) {
+      redraws -= 1;
+      trace.write(pid, events::write_event::descriptor::STDOUT, redraw);
+    } else {
+      trace.write(pid, events::write_event::descriptor::STDOUT, line);
+    }
+  }
+
+  for (size_t i = options.processes; i > 0; i--)
+    trace.exit(ROOT_PID + i - 1);
+  return trace.result();
+}
+}  // namespace workloads
@@ -0,0 +1,170 @@
+#include "terminal_lines.hpp"
+
+using namespace events;
+
+static constexpr char ESCAPE = '\x1B';
+
+static uint64_t stream_key(pid_t pid, write_event::descriptor fd) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(pid)) << 1) | (fd == write_event::descriptor::STDERR);
+}
+
+// Length of the control sequence starting at data[i], which has to be an escape character
+static size_t escape_length(std::string_view data, size_t i) {
+  if (i + 1 >= data.size() || data[i + 1] != '[')
+    return std::min<size_t>(2, data.size() - i);
+  size_t j = i + 2;
+  // parameters and intermediate bytes, then the final byte
+  while (j < data.size() && (data[j] < 0x40 || data[j] > 0x7E))
+    j++;
+  return std::min(j + 1, data.size()) - i;
+}
+
+static void strip_escapes(std::string& text) {
+  size_t out = 0;
+  for (size_t i = 0; i < text.size();) {
+    if (text[i] == ESCAPE) {
+      i += escape_length(text, i);
+    } else {
+      text[out++] = text[i++];
+    }
+  }
+  text.resize(out);
+}
+
+terminal_lines::terminal_lines(emit_function emit, std::chrono::nanoseconds window)
+    : emit(std::move(emit)), window(window) {}
+
+void terminal_lines::put(line& l, std::string_view data, size_t& i) {
+  char ch = data[i];
+  if (ch == '\r') {
+    if (!l.overwriting)
+      strip_escapes(l.text);
+    l.overwriting = true;
+    l.cursor = 0;
+    i++;
+    return;
+  }
+
+  if (!l.overwriting) {
+    l.text.push_back(ch);
+    l.cursor = l.text.size();
+    i++;
+    return;
+  }
+
+  if (ch == ESCAPE) {
+    size_t length = escape_length(data, i);
+    std::string_view sequence = data.substr(i, length);
+    // Erase in line: 0 (default) to the end, 1 to the cursor, 2 the whole line
+    if (sequence.size() >= 3 && sequence[1] == '[' && sequence.back() == 'K') {
+      std::string_view mode = sequence.substr(2, sequence.size() - 3);
+      if (mode.empty() || mode == "0")
+        l.text.resize(std::min(l.cursor, l.text.size()));
+      else if (mode == "1")
+        l.text.replace(0, std::min(l.cursor, l.text.size()), std::min(l.cursor, l.text.size()), ' ');
+      else if (mode == "2")
+        l.text.clear();
+    }
+    i += length;
+    return;
+  }
+
+  if (l.cursor < l.text.size())
+    l.text[l.cursor] = ch;
+  else {
+    l.text.resize(l.cursor, ' ');
+    l.text.push_back(ch);
+  }
+  l.cursor++;
+  i++;
+}
+
+void terminal_lines::begin_output(write_event const& e, time_point timestamp) {
+  if (!output.data.empty())
+    return;
+  output.source_pid = e.source_pid;
+  output.file_descriptor = e.file_descriptor;
+  output.timestamp = timestamp;
+}
+
+void terminal_lines::end_line(stream& s) {
+  output.data.append(s.current.text);
+  output.data.push_back('\n');
+  s.current = {};
+  s.pending = false;
+}
+
+void terminal_lines::flush_output() {
+  if (output.data.empty())
+    return;
+  emit(output);
+  output.data.clear();
+}
+
+void terminal_lines::write(write_event const& e) {
+  uint64_t key = stream_key(e.source_pid, e.file_descriptor);
+  auto it = streams.find(key);
+  bool pending = it != streams.end() && it->second.pending;
+  // The common case of complete lines is passed on without copying
+  if (!pending && !e.data.empty() && e.data.back() == '\n' && e.data.find('\r') == std::string::npos) {
+    emit(e);
+    return;
+  }
+
+  stream& s = it != streams.end() ? it->second : streams[key];
+  if (s.pending && e.timestamp - s.current.start > window) {
+    // The line stayed unfinished for too long, its current state is emitted and a redraw continues it
+    begin_output(e, s.current.start);
+    output.data.append(s.current.text);
+    output.data.push_back('\n');
+    if (!s.current.overwriting) {
+      s.current.text.clear();
+      s.current.cursor = 0;
+    }
+    s.current.start = e.timestamp;
+  }
+
+  std::string_view data = e.data;
+  for (size_t i = 0; i < data.size();) {
+    if (!s.pending) {
+      s.pending = true;
+      s.current.start = e.timestamp;
+    }
+    if (data[i] == '\n') {
+      begin_output(e, s.current.start);
+      end_line(s);
+      i++;
+    } else {
+      put(s.current, data, i);
+    }
+  }
+  flush_output();
+}
+
+void terminal_lines::flush(pid_t pid, write_event::descriptor fd) {
+  auto it = streams.find(stream_key(pid, fd));
+  if (it == streams.end())
+    return;
+  stream& s = it->second;
+  if (s.pending) {
+    output.source_pid = pid;
+    output.file_descriptor = fd;
+    output.timestamp = s.current.start;
+    output.data = s.current.text;
+    flush_output();
+  }
+  streams.erase(it);
+}
+
+void terminal_lines::flush(pid_t pid) {
+  flush(pid, write_event::descriptor::STDOUT);
+  flush(pid, write_event::descriptor::STDERR);
+}
+
+void terminal_lines::flush_all() {
+  while (!streams.empty()) {
+    uint64_t key = streams.begin()->first;
+    auto fd = (key & 1) ? write_event::descriptor::STDERR : write_event::descriptor::STDOUT;
+    flush(static_cast<pid_t>(key >> 1), fd);
+  }
+}
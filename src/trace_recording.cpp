@@ -0,0 +1,82 @@
+#include "trace_recording.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+struct file_header {
+  uint32_t magic;
+  uint32_t version;
+  int64_t boot_time;
+};
+
+struct record_header {
+  uint32_t size;
+  uint32_t padding;
+};
+}  // namespace
+
+static constexpr uint32_t MAGIC = 0x74726163;
+static constexpr uint32_t VERSION = 2;
+
+static size_t padded(size_t size) {
+  return (size + 7) / 8 * 8;
+}
+
+trace_recording::trace_recording(events::time_point boot_time) : boot_time(boot_time) {}
+
+void trace_recording::write_header(std::ostream& os, events::time_point boot_time) {
+  file_header header{MAGIC, VERSION, std::chrono::duration_cast<std::chrono::nanoseconds>(boot_time.time_since_epoch()).count()};
+  os.write(reinterpret_cast<char const *>(&header), sizeof(header));
+}
+
+void trace_recording::write_record(std::ostream& os, void const *record, size_t size) {
+  static const char zeros[8] = {};
+  record_header header{static_cast<uint32_t>(size), 0};
+  os.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  os.write(static_cast<char const *>(record), size);
+  os.write(zeros, padded(size) - size);
+}
+
+trace_recording trace_recording::load(std::filesystem::path const& path) {
+  std::ifstream file{path, std::ios::binary};
+  file_header header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != MAGIC || header.version != VERSION)
+    throw std::runtime_error{path.string() + " is not a trace recording"};
+
+  trace_recording result{events::time_point{std::chrono::duration_cast<events::time_point::duration>(std::chrono::nanoseconds{header.boot_time})}};
+  result.data.assign(std::istreambuf_iterator<char>{file}, {});
+  return result;
+}
+
+void trace_recording::save(std::filesystem::path const& path) const {
+  std::ofstream file{path, std::ios::binary};
+  write_header(file, boot_time);
+  file.write(data.data(), data.size());
+  if (!file)
+    throw std::runtime_error{"Cannot write " + path.string()};
+}
+
+void trace_recording::append(void const *record, size_t size) {
+  record_header header{static_cast<uint32_t>(size), 0};
+  size_t offset = data.size();
+  data.resize(offset + sizeof(header) + padded(size));
+  std::memcpy(data.data() + offset, &header, sizeof(header));
+  std::memcpy(data.data() + offset + sizeof(header), record, size);
+}
+
+void const *trace_recording::next(size_t& offset, size_t& size) const {
+  if (offset + sizeof(record_header) > data.size())
+    return nullptr;
+  record_header header;
+  std::memcpy(&header, data.data() + offset, sizeof(header));
+  // a record cut short when the recording was interrupted
+  if (offset + sizeof(header) + header.size > data.size())
+    return nullptr;
+  void const *record = data.data() + offset + sizeof(header);
+  size = header.size;
+  offset += sizeof(header) + padded(header.size);
+  return record;
+}
@@ -0,0 +1,152 @@
+#include "tracing_daemon.hpp"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "backend/event.h"
+
+static sockaddr_un socket_address(std::filesystem::path const& path) {
+  sockaddr_un address{.sun_family = AF_UNIX};
+  if (path.native().size() >= sizeof(address.sun_path))
+    throw std::runtime_error{"Socket path is too long: " + path.string()};
+  std::strcpy(address.sun_path, path.c_str());
+  return address;
+}
+
+// A socket which accepts connections belongs to a running daemon, otherwise it is a leftover
+static bool daemon_running(std::filesystem::path const& path) {
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  auto address = socket_address(path);
+  bool running = connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+  close(fd);
+  return running;
+}
+
+tracing_daemon::tracing_daemon(bpf_provider_options const& options, std::filesystem::path socket_path)
+    : programs(options, forward, this), socket_path(std::move(socket_path)) {
+  if (daemon_running(this->socket_path))
+    throw std::runtime_error{"A daemon is already listening on " + this->socket_path.string()};
+  std::filesystem::remove(this->socket_path);
+
+  listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  auto address = socket_address(this->socket_path);
+  // clients can read the output of every traced command, as root can,
+  // so the socket is never accessible to others, not even before the chmod
+  mode_t mask = umask(0077);
+  bool bound = bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+  umask(mask);
+  if (!bound || chmod(this->socket_path.c_str(), 0600) || listen(listener, 16)) {
+    close(listener);
+    throw std::runtime_error{"Cannot listen on " + this->socket_path.string()};
+  }
+  programs.pin(daemon_protocol::PIN_DIRECTORY);
+  std::cerr << "[tracing_daemon] Listening on " << this->socket_path.string() << "\n";
+}
+
+tracing_daemon::~tracing_daemon() {
+  for (auto const& [session, c] : clients)
+    close(c.fd);
+  programs.unpin(daemon_protocol::PIN_DIRECTORY);
+  close(listener);
+  std::filesystem::remove(socket_path);
+}
+
+int tracing_daemon::forward(void *ctx, void *data, size_t len) {
+  auto *me = static_cast<tracing_daemon *>(ctx);
+  auto const *header = static_cast<backend::event_header const *>(data);
+  auto it = me->clients.find(header->session);
+  // records of a session whose client is gone belong to nobody
+  if (it == me->clients.end())
+    return 0;
+  auto& c = it->second;
+  if (c.backlog.empty()) {
+    if (send(c.fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT) >= 0)
+      return 0;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      me->end_session(header->session);
+      return 0;
+    }
+  }
+  // the records of a session stay in order behind its backlog
+  if (c.backlog_bytes + len > MAX_BACKLOG) {
+    std::cerr << "[tracing_daemon] The client of session " << header->session
+              << " does not keep up with its records and is disconnected\n";
+    me->end_session(header->session);
+    return 0;
+  }
+  c.backlog.emplace_back(static_cast<char const *>(data), len);
+  c.backlog_bytes += len;
+  return 0;
+}
+
+bool tracing_daemon::send_backlog(client& c) {
+  while (!c.backlog.empty()) {
+    auto const& record = c.backlog.front();
+    if (send(c.fd, record.data(), record.size(), MSG_NOSIGNAL | MSG_DONTWAIT) < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    c.backlog_bytes -= record.size();
+    c.backlog.pop_front();
+  }
+  return true;
+}
+
+void tracing_daemon::accept_client() {
+  int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+  if (client < 0)
+    return;
+  uint32_t session = next_session++;
+  daemon_protocol::ready ready{.session = session};
+  if (send(client, &ready, sizeof(ready), MSG_NOSIGNAL) != sizeof(ready)) {
+    close(client);
+    return;
+  }
+  clients.emplace(session, tracing_daemon::client{client});
+}
+
+void tracing_daemon::end_session(uint32_t session) {
+  auto it = clients.find(session);
+  if (it == clients.end())
+    return;
+  close(it->second.fd);
+  clients.erase(it);
+  programs.end_session(session);
+}
+
+void tracing_daemon::run() {
+  std::vector<pollfd> descriptors;
+  std::vector<uint32_t> sessions;
+  while (!stopping) {
+    descriptors = {{programs.epoll_fd(), POLLIN}, {listener, POLLIN}};
+    sessions.clear();
+    // clients never send anything, they become readable when they disconnect
+    for (auto const& [session, c] : clients) {
+      descriptors.push_back({c.fd, static_cast<short>(c.backlog.empty() ? POLLIN : POLLIN | POLLOUT)});
+      sessions.push_back(session);
+    }
+    if (::poll(descriptors.data(), descriptors.size(), 100) <= 0)
+      continue;
+
+    if (descriptors[0].revents)
+      programs.poll(0);
+    if (descriptors[1].revents)
+      accept_client();
+    for (size_t i = 0; i < sessions.size(); i++) {
+      auto revents = descriptors[i + 2].revents;
+      auto c = clients.find(sessions[i]);
+      if (c == clients.end())
+        continue;
+      if ((revents & ~POLLOUT) || ((revents & POLLOUT) && !send_backlog(c->second)))
+        end_session(sessions[i]);
+    }
+  }
+  print_program_stats(std::cerr, programs.program_statistics());
+}
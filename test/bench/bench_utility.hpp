@@ -0,0 +1,18 @@
+#pragma once
+
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include "events.hpp"
+#include "trace_recording.hpp"
+
+// Discards everything, so that only formatting is measured
+class null_buffer : public std::streambuf {
+ protected:
+  std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+  int overflow(int c) override { return c; }
+};
+
+// Events of a recording as the pipeline receives them
+std::vector<events::event> decode_all(trace_recording const& recording);
@@ -0,0 +1,33 @@
+#include <benchmark/benchmark.h>
+
+#include <ostream>
+#include <vector>
+
+#include "bench_utility.hpp"
+#include "jsonl_logger.hpp"
+
+static std::vector<events::event> write_flood(size_t count, size_t line_length) {
+  std::vector<events::event> result;
+  auto timestamp = std::chrono::system_clock::now();
+  result.push_back(events::exec_event{{1000, timestamp}, 1000, "user", "/home/user", "make -j8"});
+  std::string line(line_length - 1, 'a');
+  line.push_back('\n');
+  for (size_t i = 0; i < count; i++)
+    result.push_back(events::write_event{{1000, timestamp + std::chrono::microseconds(i)}, events::write_event::descriptor::STDOUT, line});
+  return result;
+}
+
+static void BM_jsonl_write_flood(benchmark::State& state) {
+  auto events = write_flood(10000, state.range(0));
+  null_buffer buffer;
+  std::ostream os{&buffer};
+  jsonl_logger logger{os};
+
+  for (auto _ : state)
+    for (auto const& e : events)
+      logger.consume(e);
+
+  state.SetItemsProcessed(state.iterations() * events.size());
+  state.SetBytesProcessed(state.iterations() * events.size() * state.range(0));
+}
+BENCHMARK(BM_jsonl_write_flood)->Arg(16)->Arg(80)->Arg(1024);
@@ -0,0 +1,159 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <variant>
+
+#include "bench_utility.hpp"
+#include "replay_provider.hpp"
+#include "structure/html/html_structure_consumer.hpp"
+#include "structure/plain/plain_event_formatter.hpp"
+#include "structure/plain/plain_structure_consumer.hpp"
+#include "structure/structure_provider.hpp"
+#include "synthetic_trace.hpp"
+#include "terminal_lines.hpp"
+
+std::vector<events::event> decode_all(trace_recording const& recording) {
+  std::vector<events::event> result;
+  replay_provider provider{recording};
+  while (provider.is_active())
+    result.push_back(provider.provide().value());
+  return result;
+}
+
+static size_t output_bytes(std::vector<events::event> const& events) {
+  size_t result = 0;
+  for (auto const& e : events)
+    if (auto write = std::get_if<events::write_event>(&e))
+      result += write->data.size();
+  return result;
+}
+
+// Logs written by the benchmarks, removed before every run of the structure
+static std::filesystem::path logs_directory() {
+  auto path = std::filesystem::temp_directory_path() / "anteater-bench";
+  std::filesystem::remove_all(path);
+  return path;
+}
+
+static trace_recording write_flood(benchmark::State& state) {
+  return workloads::write_flood({.processes = 4, .writes = 10000, .line_length = static_cast<size_t>(state.range(0))});
+}
+
+static void decode(benchmark::State& state, trace_recording const& recording) {
+  size_t events = 0;
+  for (auto _ : state) {
+    // copying the recording is not measured
+    state.PauseTiming();
+    replay_provider provider{recording};
+    state.ResumeTiming();
+    while (provider.is_active()) {
+      benchmark::DoNotOptimize(provider.provide());
+      events++;
+    }
+  }
+  state.SetItemsProcessed(events);
+  state.SetBytesProcessed(state.iterations() * recording.size());
+}
+
+static void BM_decode_write_flood(benchmark::State& state) {
+  decode(state, write_flood(state));
+}
+BENCHMARK(BM_decode_write_flood)->Arg(16)->Arg(80)->Arg(1024);
+
+static void BM_decode_fork_storm(benchmark::State& state) {
+  decode(state, workloads::fork_storm(state.range(0)));
+}
+BENCHMARK(BM_decode_fork_storm)->Arg(1000)->Arg(10000);
+
+static void BM_decode_exec_chain(benchmark::State& state) {
+  decode(state, workloads::exec_chain(state.range(0)));
+}
+BENCHMARK(BM_decode_exec_chain)->Arg(100)->Arg(1000);
+
+// Provider is basic_structure_provider<Root> or the virtually dispatched structure_provider
+template <class Root, class Provider = basic_structure_provider<Root>>
+static void structure(benchmark::State& state, trace_recording const& recording) {
+  auto events = decode_all(recording);
+  for (auto _ : state) {
+    Provider provider{std::make_unique<Root>(logs_directory())};
+    for (auto const& e : events)
+      provider.consume(e);
+  }
+  state.SetItemsProcessed(state.iterations() * events.size());
+  state.SetBytesProcessed(state.iterations() * output_bytes(events));
+}
+
+// Consumes nothing, so that only the dispatch of the provider is measured
+class null_group final : public structure_consumer {
+ public:
+  using structure_consumer::consume;
+  void consume(events::fork_event const&) {}
+  std::unique_ptr<structure_consumer> consume(events::exec_event const&) { return std::make_unique<null_group>(); }
+  void consume(events::exit_event const&) {}
+  void consume(events::write_event const& e) { benchmark::DoNotOptimize(e.data.data()); }
+};
+
+class null_root : public structure_consumer {
+ public:
+  using group = null_group;
+  null_root(std::filesystem::path) {}
+  void consume(events::fork_event const&) {}
+  std::unique_ptr<structure_consumer> consume(events::exec_event const&) { return std::make_unique<null_group>(); }
+  void consume(events::exit_event const&) {}
+  void consume(events::write_event const&) {}
+};
+
+static void BM_dispatch_virtual(benchmark::State& state) {
+  structure<null_root, structure_provider>(state, write_flood(state));
+}
+BENCHMARK(BM_dispatch_virtual)->Arg(16);
+
+static void BM_dispatch_static(benchmark::State& state) {
+  structure<null_root>(state, write_flood(state));
+}
+BENCHMARK(BM_dispatch_static)->Arg(16);
+
+static void BM_html_write_flood(benchmark::State& state) {
+  structure<html_structure_consumer_root>(state, write_flood(state));
+}
+BENCHMARK(BM_html_write_flood)->Arg(80)->Arg(1024)->Unit(benchmark::kMillisecond);
+
+static void BM_html_fork_storm(benchmark::State& state) {
+  structure<html_structure_consumer_root>(state, workloads::fork_storm(state.range(0)));
+}
+BENCHMARK(BM_html_fork_storm)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+static void BM_html_exec_chain(benchmark::State& state) {
+  structure<html_structure_consumer_root>(state, workloads::exec_chain(state.range(0)));
+}
+BENCHMARK(BM_html_exec_chain)->Arg(100)->Unit(benchmark::kMillisecond);
+
+static void BM_plain_write_flood(benchmark::State& state) {
+  structure<plain_structure_consumer>(state, write_flood(state));
+}
+BENCHMARK(BM_plain_write_flood)->Arg(80)->Arg(1024)->Unit(benchmark::kMillisecond);
+
+static void BM_plain_write_flood_virtual(benchmark::State& state) {
+  structure<plain_structure_consumer, structure_provider>(state, write_flood(state));
+}
+BENCHMARK(BM_plain_write_flood_virtual)->Arg(80)->Arg(1024)->Unit(benchmark::kMillisecond);
+
+// Console output with the given percentage of redrawn colored lines
+static void BM_console_write_flood(benchmark::State& state) {
+  auto events = decode_all(workloads::write_flood({.processes = 4, .writes = 10000, .ansi_density = state.range(0) / 100.0}));
+  null_buffer buffer;
+  std::ostream os{&buffer};
+  plain_event_formatter fmt;
+  terminal_lines lines{[&](events::write_event const& e) { fmt.format(os, e); }};
+
+  for (auto _ : state) {
+    for (auto const& e : events)
+      if (auto write = std::get_if<events::write_event>(&e))
+        lines.write(*write);
+    lines.flush_all();
+    fmt.flush(os);
+  }
+  state.SetItemsProcessed(state.iterations() * events.size());
+  state.SetBytesProcessed(state.iterations() * output_bytes(events));
+}
+BENCHMARK(BM_console_write_flood)->Arg(0)->Arg(10)->Arg(50);
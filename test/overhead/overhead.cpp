@@ -0,0 +1,200 @@
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Runs the load generator natively and under anteater in every output mode
+ * and reports the slowdown of the load, the cpu time and peak memory of anteater
+ * itself and the events anteater lost.
+ *
+ * The load reports its own wall and cpu time, anteater does not wait for the traced
+ * processes, so the resource usage of the anteater process covers only anteater.
+ */
+
+struct mode {
+  std::string name;
+  // Options of anteater, empty when the load runs natively
+  std::optional<std::vector<std::string>> options;
+};
+
+struct measurement {
+  double wall_ms = 0;
+  double load_cpu_ms = 0;
+  double anteater_cpu_ms = 0;
+  double anteater_rss_mb = 0;
+  uint64_t lost_events = 0;
+};
+
+static double milliseconds(timeval t) {
+  return t.tv_sec * 1e3 + t.tv_usec / 1e3;
+}
+
+// Lost events are reported by anteater on its standard error
+static uint64_t lost_events(std::filesystem::path const& stderr_path) {
+  std::ifstream file{stderr_path};
+  std::string line;
+  uint64_t result = 0;
+  while (std::getline(file, line)) {
+    auto position = line.find(" events were lost");
+    if (position == std::string::npos)
+      continue;
+    auto start = line.rfind(' ', position - 1);
+    result += std::stoull(line.substr(start + 1, position - start - 1));
+  }
+  return result;
+}
+
+static measurement run(mode const& m, std::string const& anteater, std::vector<std::string> const& load) {
+  char directory_template[] = "/tmp/anteater-overhead-XXXXXX";
+  if (mkdtemp(directory_template) == nullptr)
+    throw std::runtime_error{"Cannot create a temporary directory"};
+  std::filesystem::path directory{directory_template};
+  auto report = directory / "report";
+  auto errors = directory / "stderr";
+
+  std::vector<std::string> args;
+  if (m.options.has_value()) {
+    args.push_back(anteater);
+    for (auto option : m.options.value()) {
+      // output files go to the temporary directory
+      if (option.starts_with("{dir}"))
+        option = (directory / option.substr(5)).string();
+      args.push_back(option);
+    }
+  }
+  args.insert(args.end(), load.begin(), load.end());
+  args.push_back("--report");
+  args.push_back(report.string());
+
+  pid_t child = fork();
+  if (child == 0) {
+    // html logs go to the temporary directory
+    setenv("HOME", directory.c_str(), 1);
+    int null = open("/dev/null", O_WRONLY);
+    int error = open(errors.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(null, STDOUT_FILENO);
+    dup2(error, STDERR_FILENO);
+    std::vector<char *> argv;
+    for (auto& arg : args)
+      argv.push_back(arg.data());
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+
+  int status;
+  rusage usage;
+  wait4(child, &status, 0, &usage);
+
+  measurement result;
+  std::ifstream report_file{report};
+  int64_t wall_ns, cpu_ns;
+  if (!(report_file >> wall_ns >> cpu_ns)) {
+    std::filesystem::remove_all(directory);
+    throw std::runtime_error{"The load did not finish in mode " + m.name};
+  }
+  result.wall_ms = wall_ns / 1e6;
+  result.load_cpu_ms = cpu_ns / 1e6;
+  if (m.options.has_value()) {
+    result.anteater_cpu_ms = milliseconds(usage.ru_utime) + milliseconds(usage.ru_stime);
+    result.anteater_rss_mb = usage.ru_maxrss / 1024.0;
+    result.lost_events = lost_events(errors);
+  }
+  std::filesystem::remove_all(directory);
+  return result;
+}
+
+// Median of every measurement, the lost events are the largest number seen
+static measurement summarize(std::vector<measurement> runs) {
+  auto median = [&](double measurement::*field) {
+    std::sort(runs.begin(), runs.end(), [&](auto const& a, auto const& b) { return a.*field < b.*field; });
+    return runs[runs.size() / 2].*field;
+  };
+  measurement result;
+  result.wall_ms = median(&measurement::wall_ms);
+  result.load_cpu_ms = median(&measurement::load_cpu_ms);
+  result.anteater_cpu_ms = median(&measurement::anteater_cpu_ms);
+  result.anteater_rss_mb = median(&measurement::anteater_rss_mb);
+  for (auto const& r : runs)
+    result.lost_events = std::max(result.lost_events, r.lost_events);
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = 5;
+  std::string output = "overhead_output.json";
+  int i = 1;
+  for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+    if (!strcmp(argv[i], "--repeat"))
+      repeat = std::max(1, atoi(argv[i + 1]));
+    else if (!strcmp(argv[i], "--out"))
+      output = argv[i + 1];
+    else
+      break;
+  }
+  if (argc - i < 2) {
+    std::cerr << "Usage: " << argv[0] << " [--repeat <n>] [--out <file>] <anteater> <load generator> [load option]...\n";
+    return 2;
+  }
+  std::string anteater = std::filesystem::absolute(argv[i]).string();
+  std::vector<std::string> load{std::filesystem::absolute(argv[i + 1]).string()};
+  load.insert(load.end(), argv + i + 2, argv + argc);
+
+  std::vector<mode> modes{
+    {"native", {}},
+    {"html", std::vector<std::string>{}},
+    {"console", std::vector<std::string>{"-L"}},
+    {"jsonl", std::vector<std::string>{"--jsonl", "{dir}events.jsonl"}},
+    {"chrome", std::vector<std::string>{"--chrome-trace", "{dir}trace.json"}},
+    {"fan-out", std::vector<std::string>{"--html", "--jsonl", "{dir}events.jsonl", "--chrome-trace", "{dir}trace.json"}},
+  };
+
+  std::cout << std::left << std::setw(10) << "mode" << std::right
+            << std::setw(12) << "wall ms" << std::setw(12) << "slowdown"
+            << std::setw(12) << "load cpu" << std::setw(14) << "anteater cpu"
+            << std::setw(14) << "anteater MB" << std::setw(14) << "lost events" << "\n";
+
+  std::ostringstream json;
+  json << "{\n  \"load\": \"";
+  for (size_t j = 1; j < load.size(); j++)
+    json << (j > 1 ? " " : "") << load[j];
+  json << "\",\n  \"modes\": [";
+
+  double native_wall = 0;
+  for (size_t j = 0; j < modes.size(); j++) {
+    auto const& m = modes[j];
+    std::vector<measurement> runs;
+    for (int k = 0; k < repeat; k++)
+      runs.push_back(run(m, anteater, load));
+    auto result = summarize(std::move(runs));
+    if (!m.options.has_value())
+      native_wall = result.wall_ms;
+    double slowdown = native_wall > 0 ? (result.wall_ms / native_wall - 1) * 100 : 0;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << std::left << std::setw(10) << m.name << std::right
+              << std::setw(12) << result.wall_ms << std::setw(11) << slowdown << "%"
+              << std::setw(12) << result.load_cpu_ms << std::setw(14) << result.anteater_cpu_ms
+              << std::setw(14) << result.anteater_rss_mb << std::setw(14) << result.lost_events << "\n";
+
+    json << (j > 0 ? "," : "") << "\n    {\"mode\": \"" << m.name << "\", \"wall_ms\": " << result.wall_ms
+         << ", \"slowdown_percent\": " << slowdown << ", \"load_cpu_ms\": " << result.load_cpu_ms
+         << ", \"anteater_cpu_ms\": " << result.anteater_cpu_ms << ", \"anteater_rss_mb\": " << result.anteater_rss_mb
+         << ", \"lost_events\": " << result.lost_events << "}";
+  }
+  json << "\n  ]\n}\n";
+  std::ofstream{output} << json.str();
+}
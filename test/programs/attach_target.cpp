@@ -0,0 +1,16 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iostream>
+
+// Waits to be attached to, then writes from itself and a forked child
+int main() {
+  sleep(1);
+  std::cout << "parent" << std::endl;
+  if (fork() == 0) {
+    std::cout << "child" << std::endl;
+    return 0;
+  }
+  wait(nullptr);
+  return 3;
+}
@@ -0,0 +1,129 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * Configurable load for measuring the overhead of tracing.
+ *
+ * --processes N    worker processes, each running the threads
+ * --threads M      threads of every worker
+ * --writes W       writes of every thread
+ * --write-size S   bytes of every write, the last one is a newline
+ * --rate R         writes per second of every thread, 0 writes as fast as possible
+ * --exec-depth D   every worker first runs a chain of D nested fork and exec
+ * --forks F        every thread forks F children which exit immediately, spread over its writes
+ * --report FILE    wall and cpu time of the whole load in nanoseconds are written to FILE
+ */
+struct options {
+    int processes = 1;
+    int threads = 1;
+    long writes = 10000;
+    size_t write_size = 80;
+    long rate = 0;
+    int exec_depth = 0;
+    int forks = 0;
+    const char *report = nullptr;
+};
+
+static void exec_chain(const char *self, int depth) {
+    if (depth <= 0) return;
+    pid_t child = fork();
+    if (child == 0) {
+        string next = to_string(depth - 1);
+        execl(self, self, "--chain", next.c_str(), nullptr);
+        _exit(127);
+    }
+    waitpid(child, nullptr, 0);
+}
+
+static void run_thread(options const& opts) {
+    string line(opts.write_size > 0 ? opts.write_size - 1 : 0, 'a');
+    line.push_back('\n');
+    long fork_every = opts.forks > 0 ? max(1L, opts.writes / opts.forks) : 0;
+    int forked = 0;
+    auto start = steady_clock::now();
+
+    for (long i = 0; i < opts.writes; i++) {
+        if (opts.rate > 0)
+            this_thread::sleep_until(start + nanoseconds(i * 1000000000L / opts.rate));
+        if (write(STDOUT_FILENO, line.data(), line.size()) < 0) exit(1);
+        if (fork_every > 0 && i % fork_every == 0 && forked < opts.forks) {
+            pid_t child = fork();
+            if (child == 0) _exit(0);
+            waitpid(child, nullptr, 0);
+            forked++;
+        }
+    }
+}
+
+static void run_worker(const char *self, options const& opts) {
+    exec_chain(self, opts.exec_depth);
+    vector<thread> threads;
+    for (int i = 1; i < opts.threads; i++)
+        threads.emplace_back(run_thread, cref(opts));
+    run_thread(opts);
+    for (auto& t : threads)
+        t.join();
+}
+
+static int64_t cpu_nanoseconds(int who) {
+    rusage usage;
+    getrusage(who, &usage);
+    auto ns = [](timeval t) { return t.tv_sec * 1000000000L + t.tv_usec * 1000L; };
+    return ns(usage.ru_utime) + ns(usage.ru_stime);
+}
+
+int main(int argc, char *argv[]) {
+    options opts;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *arg = argv[i];
+        const char *value = argv[i + 1];
+        if (!strcmp(arg, "--chain")) {
+            exec_chain(argv[0], atoi(value));
+            return 0;
+        } else if (!strcmp(arg, "--processes")) opts.processes = atoi(value);
+        else if (!strcmp(arg, "--threads")) opts.threads = atoi(value);
+        else if (!strcmp(arg, "--writes")) opts.writes = atol(value);
+        else if (!strcmp(arg, "--write-size")) opts.write_size = atol(value);
+        else if (!strcmp(arg, "--rate")) opts.rate = atol(value);
+        else if (!strcmp(arg, "--exec-depth")) opts.exec_depth = atoi(value);
+        else if (!strcmp(arg, "--forks")) opts.forks = atoi(value);
+        else if (!strcmp(arg, "--report")) opts.report = value;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 2;
+        }
+    }
+
+    auto start = steady_clock::now();
+    vector<pid_t> workers;
+    for (int i = 0; i < opts.processes; i++) {
+        pid_t child = fork();
+        if (child == 0) {
+            run_worker(argv[0], opts);
+            _exit(0);
+        }
+        workers.push_back(child);
+    }
+    for (pid_t worker : workers)
+        waitpid(worker, nullptr, 0);
+    auto wall = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+    if (opts.report != nullptr) {
+        FILE *report = fopen(opts.report, "w");
+        if (report == nullptr) return 1;
+        fprintf(report, "%ld %ld\n", (long) wall, (long) (cpu_nanoseconds(RUSAGE_SELF) + cpu_nanoseconds(RUSAGE_CHILDREN)));
+        fclose(report);
+    }
+}
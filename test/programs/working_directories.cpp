@@ -0,0 +1,20 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Executes programs twice in the same directory on another mount, then in the root directory
+static void run_true() {
+  if (fork() == 0) {
+    execlp("true", "true", nullptr);
+    _exit(1);
+  }
+  wait(nullptr);
+}
+
+int main() {
+  if (chdir("/dev/shm")) return 1;
+  run_true();
+  run_true();
+  if (chdir("/")) return 1;
+  run_true();
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "process_tree.hpp"
+#include "testing_utility.hpp"
+
+TEST(ATTACH, RUNNING_PROCESS) {
+  auto target_path = programs / "attach_target";
+  pid_t target = fork();
+  if (target == 0) {
+    execl(target_path.c_str(), "attach_target", nullptr);
+    exit(-1);
+  }
+  // the exec has to finish before attaching
+  std::this_thread::sleep_for(std::chrono::milliseconds{200});
+
+  bpf_provider provider;
+  provider.attach(target);
+  std::vector<events::event> events;
+  while (provider.is_active()) {
+    auto event = provider.provide();
+    if (event.has_value()) events.push_back(std::move(*event));
+  }
+  waitpid(target, nullptr, 0);
+
+  ASSERT_FALSE(events.empty());
+  auto first = std::get_if<events::exec_event>(&events.front());
+  ASSERT_NE(first, nullptr);
+  ASSERT_EQ(first->source_pid, target);
+  ASSERT_EQ(first->command, "attach_target");
+
+  int forks = 0;
+  std::string output;
+  std::optional<int> exit_code;
+  for (auto const& event : events) {
+    if (std::holds_alternative<events::fork_event>(event))
+      forks++;
+    if (auto write = std::get_if<events::write_event>(&event))
+      output += write->data;
+    if (auto exit = std::get_if<events::exit_event>(&event); exit != nullptr && exit->source_pid == target)
+      exit_code = exit->exit_code;
+  }
+  ASSERT_EQ(forks, 1);
+  ASSERT_EQ(output, "parent\nchild\n");
+  ASSERT_EQ(exit_code, 3);
+}
+
+TEST(ATTACH, EXITED_PROCESSES) {
+  pid_t target = fork();
+  if (target == 0) {
+    // the zombie is found in the process tree, but its exit has already been reported to nobody
+    if (fork() == 0)
+      _exit(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds{500});
+    _exit(5);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds{200});
+  ASSERT_FALSE(process_exited(target));
+
+  bpf_provider provider;
+  provider.attach(target);
+  std::vector<events::event> events;
+  while (provider.is_active()) {
+    auto event = provider.provide();
+    if (event.has_value()) events.push_back(std::move(*event));
+  }
+  ASSERT_TRUE(process_exited(target));
+  waitpid(target, nullptr, 0);
+  ASSERT_TRUE(process_exited(target));
+
+  int execs = 0;
+  for (auto const& event : events)
+    if (std::holds_alternative<events::exec_event>(event))
+      execs++;
+  ASSERT_EQ(execs, 1);
+  auto last = std::get_if<events::exit_event>(&events.back());
+  ASSERT_NE(last, nullptr);
+  ASSERT_EQ(last->exit_code, 5);
+}
@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <vector>
 
+#include "bpf_programs.hpp"
 #include "testing_utility.hpp"
 
 TEST(PROGRAMS, BASIC_EXEC) {
@@ -16,3 +20,23 @@ TEST(PROGRAMS, BASIC_EXEC) {
   ASSERT_EQ(execs[0].command, programs / "basic_exec");
   ASSERT_EQ(execs[1].command, "ls -al");
 }
+
+TEST(PROGRAMS, BASIC_EXEC_PROGRAM_STATS) {
+  if (geteuid() != 0)
+    GTEST_SKIP() << "Loading the BPF programs needs root";
+  bpf_provider_options options;
+  options.program_stats = true;
+  bpf_provider provider{options};
+  std::string command = programs / "basic_exec";
+  char *argv[] = {command.data(), nullptr};
+  provider.run(argv);
+  while (provider.is_active())
+    provider.provide();
+
+  auto const& stats = provider.program_statistics();
+  auto exec = std::find_if(stats.begin(), stats.end(), [](program_stats const& s) { return s.name == "handle_exec"; });
+  ASSERT_NE(exec, stats.end());
+  ASSERT_GT(exec->run_count, 0);
+  // handle_exec counts the execs of untraced tasks
+  ASSERT_TRUE(exec->untraced.has_value());
+}
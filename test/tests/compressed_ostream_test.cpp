@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <filesystem>
+#include <string>
+
+#include "compressed_ostream.hpp"
+
+static std::string decompress(std::filesystem::path const& path) {
+  gzFile file = gzopen(path.c_str(), "rb");
+  EXPECT_NE(file, nullptr);
+  std::string result;
+  char buffer[4096];
+  int read;
+  while ((read = gzread(file, buffer, sizeof(buffer))) > 0)
+    result.append(buffer, read);
+  gzclose(file);
+  return result;
+}
+
+TEST(COMPRESSED_OSTREAM, ROUND_TRIP) {
+  auto path = std::filesystem::temp_directory_path() / "anteater_compressed_ostream_test.gz";
+  std::string expected;
+  {
+    compressed_ostream os{path};
+    for (int i = 0; i < 100000; i++) {
+      std::string line = "main.cpp:" + std::to_string(i) + ": warning: unused variable\n";
+      os << line << std::flush;
+      expected += line;
+    }
+    std::string big(1 << 20, 'x');
+    os.write(big.data(), big.size());
+    expected += big;
+  }
+  compressed_ostream::wait_for_pending();
+
+  ASSERT_EQ(decompress(path), expected);
+  ASSERT_LT(std::filesystem::file_size(path) * 10, expected.size());
+  std::filesystem::remove(path);
+}
+
+TEST(COMPRESSED_OSTREAM, REWRITE) {
+  auto path = std::filesystem::temp_directory_path() / "anteater_compressed_ostream_rewrite.gz";
+  for (int i = 0; i < 10; i++) {
+    compressed_ostream os{path};
+    os << std::string(300000, 'a' + i);
+  }
+  compressed_ostream::wait_for_pending();
+
+  ASSERT_EQ(decompress(path), std::string(300000, 'a' + 9));
+  std::filesystem::remove(path);
+}
+
+TEST(COMPRESSED_OSTREAM, APPEND) {
+  auto path = std::filesystem::temp_directory_path() / "anteater_compressed_ostream_append.gz";
+  {
+    compressed_ostream os{path};
+  }
+  for (int i = 0; i < 3; i++) {
+    compressed_ostream os{path, true};
+    os << "part " << i << "\n";
+  }
+  compressed_ostream::wait_for_pending();
+
+  ASSERT_EQ(decompress(path), "part 0\npart 1\npart 2\n");
+  std::filesystem::remove(path);
+}
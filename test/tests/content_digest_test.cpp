@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+
+#include "content_digest.hpp"
+#include "run_digests.hpp"
+
+using namespace events;
+
+static uint64_t xxh64_of(std::string_view data) {
+  xxh64 hash;
+  hash.update(data);
+  return hash.digest();
+}
+
+static write_event write(pid_t pid, std::string data, write_event::descriptor fd = write_event::descriptor::STDOUT) {
+  write_event e{};
+  e.source_pid = pid;
+  e.file_descriptor = fd;
+  e.data = std::move(data);
+  return e;
+}
+
+static exec_event program(std::string_view command) {
+  exec_event e{};
+  e.command = command;
+  e.working_directory = "/build";
+  return e;
+}
+
+TEST(CONTENT_DIGEST, XXH64_REFERENCE_VALUES) {
+  ASSERT_EQ(xxh64_of(""), 0xEF46DB3751D8E999ull);
+  ASSERT_EQ(xxh64_of("a"), 0xD24EC4F1A98C6E5Bull);
+  ASSERT_EQ(xxh64_of("abc"), 0x44BC2CF5AD770999ull);
+  ASSERT_EQ(xxh64_of("message digest"), 0x066ED728FCEEB3BEull);
+  ASSERT_EQ(xxh64_of("abcdefghijklmnopqrstuvwxyz"), 0xCFE1F278FA89835Cull);
+  ASSERT_EQ(
+    xxh64_of("12345678901234567890123456789012345678901234567890123456789012345678901234567890"),
+    0xE04A477F19EE145Dull
+  );
+}
+
+TEST(CONTENT_DIGEST, XXH64_STREAMING) {
+  std::string data;
+  for (int i = 0; i < 1000; i++)
+    data += std::to_string(i * 7919);
+  for (size_t piece : {1, 3, 31, 32, 33, 100}) {
+    xxh64 hash;
+    for (size_t i = 0; i < data.size(); i += piece)
+      hash.update(std::string_view{data}.substr(i, piece));
+    ASSERT_EQ(hash.digest(), xxh64_of(data)) << piece;
+  }
+}
+
+TEST(CONTENT_DIGEST, INTERLEAVING_DOES_NOT_MATTER) {
+  output_digest a;
+  a.write(write(1, "one\n"));
+  a.write(write(2, "two\n"));
+  a.write(write(1, "error\n", write_event::descriptor::STDERR));
+  a.write(write(1, "three\n"));
+
+  output_digest b;
+  b.write(write(20, "two\n"));
+  b.write(write(10, "error\n", write_event::descriptor::STDERR));
+  b.write(write(10, "one\nthr"));
+  b.exit(20);
+  b.write(write(10, "ee\n"));
+
+  ASSERT_EQ(a.digest(program("make"), 0), b.digest(program("make"), 0));
+}
+
+TEST(CONTENT_DIGEST, REDRAWN_LINES_COUNT_ONCE) {
+  output_digest a;
+  a.write(write(1, "downloading 10%\rdownloading 60%\r"));
+  a.write(write(1, "downloading 100%\r\ndone\n"));
+
+  output_digest b;
+  b.write(write(1, "downloading 100%\ndone\n"));
+
+  ASSERT_EQ(a.digest(program("wget"), 0), b.digest(program("wget"), 0));
+}
+
+TEST(CONTENT_DIGEST, LONG_LINES_ARE_HASHED_IN_PIECES) {
+  std::string piece(1000, 'x');
+  output_digest a;
+  for (size_t written = 0; written < 4 * output_digest::MAX_LINE; written += piece.size())
+    a.write(write(1, piece));
+  a.write(write(1, "\n"));
+
+  std::string line;
+  for (size_t written = 0; written < 4 * output_digest::MAX_LINE; written += piece.size())
+    line += piece;
+  output_digest b;
+  b.write(write(1, line + "\n"));
+
+  ASSERT_EQ(a.digest(program("yes"), 0), b.digest(program("yes"), 0));
+}
+
+TEST(CONTENT_DIGEST, CHANGES_ARE_DETECTED) {
+  auto digest = [](std::string output, std::string_view command = "cc", std::optional<int> exit_code = 0) {
+    output_digest d;
+    d.write(write(1, std::move(output)));
+    return d.digest(program(command), exit_code);
+  };
+  auto base = digest("ok\n");
+  ASSERT_EQ(base, digest("ok\n"));
+  ASSERT_NE(base, digest("ok!\n"));
+  ASSERT_NE(base, digest("ok\n", "ld"));
+  ASSERT_NE(base, digest("ok\n", "cc", 1));
+  ASSERT_NE(base, digest("ok\n", "cc", std::nullopt));
+
+  output_digest stderr_output;
+  stderr_output.write(write(1, "ok\n", write_event::descriptor::STDERR));
+  ASSERT_NE(base, stderr_output.digest(program("cc"), 0));
+}
+
+TEST(CONTENT_DIGEST, DIFF_MATCHES_BY_COMMAND) {
+  std::vector<group_digest> a{
+    {"make", "/build", 0, 1},
+    {"cc a.c", "/build", 0, 2},
+    {"cc b.c", "/build", 0, 3},
+    {"test", "/build", 0, 4},
+    {"lint", "/build", 0, 5},
+  };
+  std::vector<group_digest> b{
+    {"make", "/build", 2, 10},
+    {"cc b.c", "/build", 0, 3},
+    {"cc a.c", "/build", 0, 2},
+    {"test", "/build", 1, 40},
+    {"deploy", "/build", 0, 6},
+  };
+  auto changes = run_digests::diff(a, b);
+  ASSERT_EQ(changes.size(), 4);
+  ASSERT_EQ(changes[0].command, "make");
+  ASSERT_EQ(changes[0].exit_code_a, 0);
+  ASSERT_EQ(changes[0].exit_code_b, 2);
+  ASSERT_EQ(changes[1].command, "test");
+  ASSERT_EQ(changes[2].command, "deploy");
+  ASSERT_EQ(changes[2].count_a, 0);
+  ASSERT_EQ(changes[3].command, "lint");
+  ASSERT_EQ(changes[3].count_b, 0);
+}
+
+TEST(CONTENT_DIGEST, DIFF_OF_REPEATED_COMMANDS) {
+  // Three runs of a test in a different order, one of them changed
+  std::vector<group_digest> a{{"test", "/", 0, 1}, {"test", "/", 0, 2}, {"test", "/", 0, 3}};
+  std::vector<group_digest> b{{"test", "/", 0, 3}, {"test", "/", 0, 1}, {"test", "/", 0, 2}};
+  ASSERT_TRUE(run_digests::diff(a, b).empty());
+
+  b[0].digest = 4;
+  auto changes = run_digests::diff(a, b);
+  ASSERT_EQ(changes.size(), 1);
+  ASSERT_EQ(changes[0].count_a, 3);
+  ASSERT_EQ(changes[0].count_b, 3);
+  ASSERT_EQ(changes[0].changed, 2);
+}
+
+TEST(CONTENT_DIGEST, SAVE_AND_LOAD) {
+  auto path = std::filesystem::temp_directory_path() / "anteater_digests_test";
+  std::vector<group_digest> digests{{"make all", "/build", 0, 0x123456789abcdefull}, {"sleep 100", "/", std::nullopt, 7}};
+  run_digests::save(path, digests);
+  auto loaded = run_digests::load(path);
+  std::filesystem::remove(path);
+  ASSERT_EQ(loaded.size(), 2);
+  ASSERT_EQ(loaded[0].command, "make all");
+  ASSERT_EQ(loaded[0].working_directory, "/build");
+  ASSERT_EQ(loaded[0].exit_code, 0);
+  ASSERT_EQ(loaded[0].digest, 0x123456789abcdefull);
+  ASSERT_FALSE(loaded[1].exit_code.has_value());
+}
+
+TEST(CONTENT_DIGEST, LOAD_STOPS_AT_A_CORRUPT_RECORD) {
+  auto path = std::filesystem::temp_directory_path() / "anteater_corrupt_digests_test";
+  std::vector<group_digest> digests{{"make", "/build", 0, 1}, {"cc", "/build", 0, 2}};
+  run_digests::save(path, digests);
+  {
+    // command_size of the second record, which follows the file header and the first record with its strings
+    std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+    file.seekp(8 + 24 + 4 + 6 + 16);
+    uint32_t size = 0xffffffff;
+    file.write(reinterpret_cast<char const *>(&size), sizeof(size));
+  }
+  auto loaded = run_digests::load(path);
+  std::filesystem::remove(path);
+  ASSERT_EQ(loaded.size(), 1);
+  ASSERT_EQ(loaded[0].command, "make");
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <future>
+#include <thread>
+
+#include "testing_utility.hpp"
+#include "tracing_daemon.hpp"
+
+static const std::filesystem::path socket_path = std::filesystem::temp_directory_path() / "anteater_test.sock";
+
+template <class T>
+static std::vector<T> events_of_type(std::vector<events::event> const& events) {
+  std::vector<T> result;
+  for (auto const& event : events)
+    if (auto e = std::get_if<T>(&event))
+      result.push_back(*e);
+  return result;
+}
+
+TEST(DAEMON, SEQUENTIAL_CLIENTS) {
+  tracing_daemon daemon{{}, socket_path};
+  std::thread server{&tracing_daemon::run, &daemon};
+
+  bpf_provider_options options;
+  options.daemon_socket = socket_path;
+  for (int i = 0; i < 2; i++) {
+    auto events = run_bpf_provider({programs / "basic_exec"}, options);
+    auto execs = events_of_type<events::exec_event>(events);
+    ASSERT_EQ(execs.size(), 2);
+    ASSERT_EQ(execs[0].command, programs / "basic_exec");
+    ASSERT_EQ(execs[1].command, "ls -al");
+    ASSERT_EQ(events_of_type<events::exit_event>(events).size(), 1);
+  }
+
+  daemon.stop();
+  server.join();
+}
+
+TEST(DAEMON, CONCURRENT_CLIENTS) {
+  tracing_daemon daemon{{}, socket_path};
+  std::thread server{&tracing_daemon::run, &daemon};
+
+  bpf_provider_options options;
+  options.daemon_socket = socket_path;
+  auto forks = std::async(std::launch::async, [&] { return run_bpf_provider({programs / "basic_fork"}, options); });
+  auto execs = std::async(std::launch::async, [&] { return run_bpf_provider({programs / "basic_exec"}, options); });
+
+  // every session receives only the events of its own command
+  auto fork_events = forks.get();
+  ASSERT_EQ(events_of_type<events::fork_event>(fork_events).size(), 15);
+  ASSERT_EQ(events_of_type<events::write_event>(fork_events).size(), 15);
+  ASSERT_EQ(events_of_type<events::exec_event>(fork_events).size(), 1);
+
+  auto exec_events = execs.get();
+  ASSERT_EQ(events_of_type<events::fork_event>(exec_events).size(), 0);
+  ASSERT_EQ(events_of_type<events::exec_event>(exec_events).size(), 2);
+
+  daemon.stop();
+  server.join();
+}
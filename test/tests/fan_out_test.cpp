@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "fan_out.hpp"
+
+using descriptor = events::write_event::descriptor;
+
+struct recorder {
+  std::vector<events::event>& events;
+  std::atomic<bool> const* blocked = nullptr;
+
+  void consume(events::event const& e) {
+    while (blocked != nullptr && *blocked)
+      std::this_thread::yield();
+    events.push_back(e);
+  }
+};
+
+static events::write_event write(int i) {
+  return {{1, {}}, descriptor::STDOUT, std::to_string(i) + "\n"};
+}
+
+TEST(FAN_OUT, EVERY_BACKEND_GETS_EVERY_EVENT) {
+  std::vector<events::event> first, second;
+  {
+    fan_out outputs;
+    outputs.add("first", [&] { return std::make_unique<recorder>(first); });
+    outputs.add("second", [&] { return std::make_unique<recorder>(second); });
+    for (int i = 0; i < 10000; i++)
+      outputs.consume(write(i));
+    outputs.consume(events::exit_event{{1, {}}, 0});
+  }
+  ASSERT_EQ(first.size(), 10001);
+  ASSERT_EQ(second.size(), 10001);
+  for (int i = 0; i < 10000; i++)
+    ASSERT_EQ(std::get<events::write_event>(second[i]).data, std::to_string(i) + "\n");
+  ASSERT_TRUE(std::holds_alternative<events::exit_event>(first.back()));
+}
+
+TEST(FAN_OUT, SLOW_BACKEND_DROPS_WRITES) {
+  std::vector<events::event> fast, slow;
+  std::atomic<bool> blocked = true;
+  {
+    fan_out outputs;
+    outputs.add("fast", [&] { return std::make_unique<recorder>(fast); });
+    outputs.add("slow", [&] { return std::make_unique<recorder>(slow, &blocked); }, 16);
+    for (int i = 0; i < 1000; i++)
+      outputs.consume(write(i));
+    blocked = false;
+    outputs.consume(events::exit_event{{1, {}}, 0});
+  }
+  ASSERT_EQ(fast.size(), 1001);
+  ASSERT_LT(slow.size(), 100);
+  // the exit waited for room in the queue
+  ASSERT_TRUE(std::holds_alternative<events::exit_event>(slow.back()));
+}
+
+TEST(FAN_OUT, SLOW_BACKEND_DOES_NOT_HOLD_UP_THE_OTHERS) {
+  std::vector<events::event> fast, slow;
+  std::atomic<bool> blocked = true;
+  {
+    fan_out outputs;
+    outputs.add("fast", [&] { return std::make_unique<recorder>(fast); });
+    outputs.add("slow", [&] { return std::make_unique<recorder>(slow, &blocked); }, 16);
+    // more exits than the queue of the slow backend holds, while it does not consume any
+    for (int i = 0; i < 100; i++)
+      outputs.consume(events::exit_event{{1, {}}, i});
+    blocked = false;
+  }
+  ASSERT_EQ(fast.size(), 100);
+  ASSERT_EQ(slow.size(), 100);
+  for (int i = 0; i < 100; i++)
+    ASSERT_EQ(std::get<events::exit_event>(slow[i]).exit_code, i);
+}
+
+struct gap_recorder : recorder {
+  size_t& elided_bytes;
+  // Number of events received before the last gap
+  size_t& last_gap;
+
+  using recorder::consume;
+  void consume(pid_t pid, output_elided const& e) {
+    ASSERT_EQ(pid, 1);
+    elided_bytes += e.bytes;
+    last_gap = events.size();
+  }
+};
+
+TEST(FAN_OUT, DROPPED_WRITES_LEAVE_A_GAP) {
+  std::vector<events::event> slow;
+  std::atomic<bool> blocked = true;
+  size_t written = 0, elided = 0, last_gap = 0;
+  {
+    fan_out outputs;
+    outputs.add("slow", [&] { return std::make_unique<gap_recorder>(recorder{slow, &blocked}, elided, last_gap); }, 16);
+    for (int i = 0; i < 1000; i++) {
+      auto e = write(i);
+      written += e.data.size();
+      outputs.consume(std::move(e));
+    }
+    blocked = false;
+    outputs.consume(events::exit_event{{1, {}}, 0});
+  }
+  size_t received = 0;
+  for (auto const& e : slow)
+    if (auto w = std::get_if<events::write_event>(&e))
+      received += w->data.size();
+  ASSERT_GT(elided, 0);
+  ASSERT_EQ(received + elided, written);
+  // the gap is passed on before the exit
+  ASSERT_LT(last_gap, slow.size());
+  ASSERT_TRUE(std::holds_alternative<events::exit_event>(slow.back()));
+}
+
+struct failing {
+  void consume(events::event const&) { throw std::runtime_error{"disk full"}; }
+};
+
+TEST(FAN_OUT, FAILED_BACKEND_IS_SKIPPED) {
+  std::vector<events::event> working;
+  {
+    fan_out outputs{16};
+    outputs.add("failing", [] { return std::make_unique<failing>(); });
+    outputs.add("working", [&] { return std::make_unique<recorder>(working); });
+    for (int i = 0; i < 1000; i++)
+      outputs.consume(events::exit_event{{1, {}}, i});
+  }
+  ASSERT_EQ(working.size(), 1000);
+}
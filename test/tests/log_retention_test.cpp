@@ -0,0 +1,26 @@
+#include <gtest/gtest.h>
+
+#include "log_retention.hpp"
+
+using namespace std::chrono_literals;
+
+static const events::time_point now{std::chrono::hours{24 * 365}};
+
+static run_info run(std::string directory, std::chrono::hours age, uintmax_t bytes, int exit_code = 0) {
+  return {.directory = directory, .start = now - age, .end = now - age, .exit_code = exit_code, .bytes = bytes};
+}
+
+TEST(LOG_RETENTION, POLICY) {
+  std::vector<run_info> runs{
+    run("a", 1h, 10),
+    run("b", 2h, 10, 1),
+    run("c", 3h, 10),
+    run("d", 50h, 10),
+    run("e", 4h, 10),
+  };
+
+  ASSERT_EQ(expired_runs(runs, {.max_runs = 2}, now), (std::vector<std::string>{"e", "d"}));
+  ASSERT_EQ(expired_runs(runs, {.max_age = 48h}, now), (std::vector<std::string>{"d"}));
+  ASSERT_EQ(expired_runs(runs, {.max_total_bytes = 25}, now), (std::vector<std::string>{"e", "d"}));
+  ASSERT_EQ(expired_runs(runs, {.max_runs = 1, .keep_failed = false}, now), (std::vector<std::string>{"b", "c", "e", "d"}));
+}
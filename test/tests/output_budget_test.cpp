@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "structure/output_budget.hpp"
+
+static events::write_event write(std::string data, int second = 0) {
+  return {{1, events::time_point{std::chrono::seconds{second}}}, events::write_event::descriptor::STDOUT, std::move(data)};
+}
+
+TEST(OUTPUT_BUDGET, UNDER_HEAD) {
+  output_budget budget{{.head = 10, .tail = 4}};
+  ASSERT_EQ(budget.admit(write("abc")), 3);
+  ASSERT_EQ(budget.admit(write("defghij")), 7);
+  ASSERT_FALSE(budget.take().has_value());
+}
+
+TEST(OUTPUT_BUDGET, HEAD_AND_TAIL) {
+  output_budget budget{{.head = 4, .tail = 6}};
+  ASSERT_EQ(budget.admit(write("abcdef", 1)), 4);
+  for (int i = 0; i < 10; i++)
+    ASSERT_EQ(budget.admit(write("0123", 2 + i)), 0);
+
+  auto retained = budget.take();
+  ASSERT_TRUE(retained.has_value());
+  std::string tail;
+  for (auto const& e : retained->tail) tail += e.data;
+  ASSERT_EQ(tail, "230123");
+  // 2 bytes left from the first write and 40 written after it
+  ASSERT_EQ(retained->elided.bytes, 2 + 40 - 6);
+  ASSERT_EQ(retained->elided.timestamp, events::time_point{std::chrono::seconds{1}});
+
+  ASSERT_FALSE(budget.take().has_value());
+  ASSERT_EQ(budget.admit(write("x")), 0);
+  ASSERT_EQ(budget.take()->tail.front().data, "x");
+}
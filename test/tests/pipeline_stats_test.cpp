@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <ctime>
+#include <sstream>
+
+#include "pipeline_stats.hpp"
+
+TEST(PIPELINE_STATS, SMALL_VALUES_ARE_EXACT) {
+  log_histogram histogram;
+  for (uint64_t i = 0; i < 10; i++)
+    histogram.record(i);
+  auto summary = histogram.summarize();
+  ASSERT_EQ(summary.count, 10);
+  ASSERT_EQ(summary.p50, 4);
+  ASSERT_EQ(summary.p90, 8);
+  ASSERT_EQ(summary.max, 9);
+}
+
+TEST(PIPELINE_STATS, RELATIVE_ERROR) {
+  log_histogram histogram;
+  for (uint64_t i = 1; i <= 100000; i++)
+    histogram.record(i * 1000);
+  auto summary = histogram.summarize();
+  ASSERT_EQ(summary.count, 100000);
+  ASSERT_EQ(summary.max, 100000000);
+  // values of a bucket are within 1/16 of each other
+  ASSERT_NEAR(summary.p50, 50000000, 50000000 / 16);
+  ASSERT_NEAR(summary.p99, 99000000, 99000000 / 16);
+  ASSERT_LE(summary.p999, summary.max);
+}
+
+TEST(PIPELINE_STATS, LARGEST_VALUES) {
+  log_histogram histogram;
+  histogram.record(UINT64_MAX);
+  ASSERT_EQ(histogram.summarize().p50, UINT64_MAX);
+}
+
+TEST(PIPELINE_STATS, RATES) {
+  pipeline_stats stats;
+  stats.received(pipeline_stats::WRITE, 100);
+  auto previous = stats.current();
+  stats.received(pipeline_stats::WRITE, 100);
+  stats.received(pipeline_stats::WRITE, 100);
+
+  std::ostringstream os;
+  stats.write_json(os, previous, std::chrono::seconds{2});
+  ASSERT_NE(os.str().find("\"write\": {\"count\": 3, \"bytes\": 300, \"per_second\": 1.0, \"bytes_per_second\": 100.0}"), std::string::npos);
+}
+
+TEST(PIPELINE_STATS, LATENCY_ON_THE_MONOTONIC_CLOCK) {
+  // an origin far from the wall clock, as when the boot time is estimated poorly
+  auto origin = events::time_point{} + std::chrono::hours{24 * 365};
+  pipeline_stats stats;
+  stats.set_clock_origin(origin);
+
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  events::exit_event e{};
+  e.timestamp = origin + std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec} - std::chrono::milliseconds{5};
+  stats.consumed(e);
+
+  auto summary = stats.latency.summarize();
+  ASSERT_EQ(summary.count, 1);
+  ASSERT_GE(summary.max, 5000000);
+  ASSERT_LT(summary.max, 1000000000);
+}
@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+
+#include "structure/process_timeline.hpp"
+
+static events::time_point at(int millis) {
+  return events::time_point{std::chrono::milliseconds{millis}};
+}
+
+TEST(PROCESS_TIMELINE, CRITICAL_PATH) {
+  process_timeline timeline;
+
+  // make -> (a, b in parallel) -> c which waits for b
+  auto make = timeline.begin({}, at(0), "make", "make.html");
+  auto a = timeline.begin(make, at(1), "a", "a.html");
+  auto b = timeline.begin(make, at(2), "b", "b.html");
+  timeline.end(a, at(3));
+  timeline.end(b, at(5));
+  auto c = timeline.begin(make, at(6), "c", "c.html");
+  timeline.end(c, at(9));
+  timeline.end(make, at(10));
+  timeline.finish();
+
+  std::vector<process_timeline::node_id> expected = {make, b, c};
+  ASSERT_EQ(timeline.critical_path(), expected);
+}
+
+TEST(PROCESS_TIMELINE, LANES) {
+  process_timeline timeline;
+
+  auto root = timeline.begin({}, at(0), "root", "root.html");
+  auto a = timeline.begin(root, at(1), "a", "a.html");
+  auto b = timeline.begin(root, at(1), "b", "b.html");
+  timeline.end(a, at(2));
+  auto c = timeline.begin(root, at(3), "c", "c.html");
+  timeline.finish();
+
+  ASSERT_EQ(timeline.lanes(), 3);
+  ASSERT_EQ(timeline.nodes()[c].lane, timeline.nodes()[a].lane);
+  ASSERT_NE(timeline.nodes()[b].lane, timeline.nodes()[a].lane);
+  ASSERT_TRUE(timeline.nodes()[c].critical);
+}
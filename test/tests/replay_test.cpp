@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <variant>
+#include <vector>
+
+#include "backend/event.h"
+#include "replay_provider.hpp"
+#include "synthetic_trace.hpp"
+
+using descriptor = events::write_event::descriptor;
+
+static std::vector<events::event> replay(trace_recording recording) {
+  std::vector<events::event> result;
+  replay_provider provider{std::move(recording)};
+  while (provider.is_active())
+    result.push_back(provider.provide().value());
+  return result;
+}
+
+TEST(REPLAY, ROUND_TRIP) {
+  synthetic_trace trace;
+  trace.exec(100, "make -j8", "/home/user/project")
+    .fork(100, 101)
+    .exec(101, "cc -c main.c", "/home/user/project")
+    .write(101, descriptor::STDERR, "warning: unused variable\n")
+    .exit(101, 1)
+    .exit(100, 2);
+
+  auto path = std::filesystem::temp_directory_path() / "anteater-replay-test.trace";
+  trace.result().save(path);
+  auto events = replay(trace_recording::load(path));
+  std::filesystem::remove(path);
+
+  ASSERT_EQ(events.size(), 6);
+  auto const& exec = std::get<events::exec_event>(events[0]);
+  ASSERT_EQ(exec.source_pid, 100);
+  ASSERT_EQ(exec.command, "make -j8");
+  ASSERT_EQ(exec.working_directory, "/home/user/project");
+  ASSERT_EQ(std::get<events::fork_event>(events[1]).child_pid, 101);
+  // the path of the second exec in the directory comes from the first one
+  ASSERT_EQ(std::get<events::exec_event>(events[2]).working_directory, "/home/user/project");
+  auto const& write = std::get<events::write_event>(events[3]);
+  ASSERT_EQ(write.file_descriptor, descriptor::STDERR);
+  ASSERT_EQ(write.data, "warning: unused variable\n");
+  ASSERT_EQ(std::get<events::exit_event>(events[4]).exit_code, 1);
+  ASSERT_EQ(std::get<events::exit_event>(events[5]).exit_code, 2);
+  ASSERT_LT(exec.timestamp, write.timestamp);
+}
+
+TEST(REPLAY, TRUNCATED_RECORD) {
+  auto recording = workloads::fork_storm(10);
+  auto path = std::filesystem::temp_directory_path() / "anteater-truncated-test.trace";
+  recording.save(path);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+  auto events = replay(trace_recording::load(path));
+  std::filesystem::remove(path);
+
+  // the exit of the root process was cut short
+  ASSERT_EQ(events.size(), 1 + 10 * 3);
+}
+
+TEST(REPLAY, NOT_A_RECORDING) {
+  auto path = std::filesystem::temp_directory_path() / "anteater-not-a-recording.trace";
+  std::ofstream{path} << "hello";
+  ASSERT_THROW(trace_recording::load(path), std::runtime_error);
+  std::filesystem::remove(path);
+}
+
+TEST(REPLAY, CORRUPT_RECORDS) {
+  auto replay_record = [](auto const& record, size_t size) {
+    trace_recording recording{events::time_point{}};
+    recording.append(&record, size);
+    replay_provider provider{std::move(recording)};
+    return provider.provide();
+  };
+
+  backend::write_event write{backend::WRITE, 1, 0, backend::STDOUT, 100, 1 << 20};
+  ASSERT_THROW(replay_record(write, sizeof(write)), std::runtime_error);
+  write.size = -1;
+  ASSERT_THROW(replay_record(write, sizeof(write)), std::runtime_error);
+
+  backend::exec_event exec{backend::EXEC, 1, 0, 100, 1000, 16, 0, 0};
+  ASSERT_THROW(replay_record(exec, sizeof(exec)), std::runtime_error);
+
+  backend::fork_event fork{static_cast<backend::event_type>(7), 1, 0, 100, 101};
+  ASSERT_THROW(replay_record(fork, sizeof(fork)), std::runtime_error);
+  fork.type = backend::FORK;
+  ASSERT_THROW(replay_record(fork, sizeof(fork) - 4), std::runtime_error);
+  ASSERT_TRUE(replay_record(fork, sizeof(fork)).has_value());
+}
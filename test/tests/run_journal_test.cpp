@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include "run_journal.hpp"
+
+static const std::filesystem::path journal_path = std::filesystem::temp_directory_path() / "anteater_test.journal";
+
+static journal_record record(journal_record::type kind, std::string directory, std::optional<int> exit_code = {}) {
+  journal_record result{kind};
+  result.run.directory = directory;
+  result.run.command = "command of " + directory;
+  result.run.exit_code = exit_code;
+  return result;
+}
+
+TEST(RUN_JOURNAL, APPEND) {
+  std::filesystem::remove(journal_path);
+  {
+    run_journal journal{journal_path};
+    journal.append(record(journal_record::type::START, "a"));
+    journal.append(record(journal_record::type::START, "b"));
+    journal.append(record(journal_record::type::FINISH, "b", 1));
+    journal.append(record(journal_record::type::FINISH, "a", 0));
+  }
+
+  run_journal journal{journal_path};
+  ASSERT_EQ(journal.size(), 4);
+  auto records = journal.read_all();
+  ASSERT_EQ(records[0].kind, journal_record::type::START);
+  ASSERT_EQ(records[2].run.directory, "b");
+  ASSERT_EQ(records[2].run.command, "command of b");
+  ASSERT_EQ(records[2].run.exit_code, 1);
+  ASSERT_EQ(records[2].sequence, 0);
+  ASSERT_EQ(records[3].sequence, 1);
+  ASSERT_FALSE(records[0].run.exit_code.has_value());
+
+  std::vector<std::string> newest;
+  journal.read_backwards([&](journal_record const& r) {
+    newest.push_back(r.run.directory);
+    return newest.size() < 2;
+  });
+  ASSERT_EQ(newest, (std::vector<std::string>{"a", "b"}));
+  std::filesystem::remove(journal_path);
+}
+
+TEST(RUN_JOURNAL, REWRITE) {
+  std::filesystem::remove(journal_path);
+  run_journal journal{journal_path};
+  for (int i = 0; i < 10; i++)
+    journal.append(record(journal_record::type::FINISH, std::to_string(i)));
+
+  auto records = journal.read_all();
+  std::erase_if(records, [](journal_record const& r) { return r.run.directory < "5"; });
+  journal.rewrite(records);
+  journal.append(record(journal_record::type::FINISH, "10"));
+
+  ASSERT_EQ(journal.size(), 6);
+  for (size_t i = 0; i < journal.size(); i++)
+    ASSERT_EQ(journal.read(i).sequence, i);
+  ASSERT_EQ(journal.read(5).run.directory, "10");
+  ASSERT_FALSE(std::filesystem::exists(journal_path.string() + ".tmp"));
+  std::filesystem::remove(journal_path);
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <vector>
 
 #include "testing_utility.hpp"
@@ -19,6 +20,46 @@ TEST(PROGRAMS, STRESS) {
   ASSERT_EQ(count, 1000);
 }
 
+// Output of the stress program and the write events carrying it
+struct stress_output {
+  std::string data;
+  size_t writes = 0;
+  size_t largest_write = 0;
+};
+
+static stress_output run_stress(bpf_provider_options options = {}) {
+  stress_output result;
+  for (auto const& event : run_bpf_provider({programs / "stress"}, options)) {
+    if (auto write = std::get_if<events::write_event>(&event)) {
+      result.writes++;
+      result.data += write->data;
+      result.largest_write = std::max(result.largest_write, write->data.size());
+    }
+  }
+  return result;
+}
+
+TEST(PROGRAMS, COALESCED_WRITES) {
+  bpf_provider_options options{
+    .coalesce_window = std::chrono::seconds{1},
+    .coalesce_limit = 8 * 1024,
+  };
+  auto separate = run_stress();
+  auto merged = run_stress(options);
+
+  ASSERT_EQ(merged.data, separate.data);
+  ASSERT_LT(merged.writes, 1000);
+  ASSERT_LE(merged.largest_write, options.coalesce_limit);
+}
+
+TEST(PROGRAMS, STAGED_WRITES) {
+  auto separate = run_stress();
+  auto staged = run_stress({.stage_writes = true});
+
+  ASSERT_EQ(staged.data, separate.data);
+  ASSERT_LE(staged.writes, separate.writes);
+}
+
 TEST(PROGRAMS, QUEUE_OVERFLOW) {
   int count = 0;
 
@@ -0,0 +1,29 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "string_pool.hpp"
+
+TEST(STRING_POOL, DEDUPLICATES) {
+  events::string_pool pool;
+  std::string cwd = "/home/user/project";
+
+  auto first = pool.intern(cwd);
+  cwd[1] = 'H';
+  auto second = pool.intern("/home/user/project");
+
+  ASSERT_EQ(first, "/home/user/project");
+  ASSERT_EQ(first.data(), second.data());
+}
+
+TEST(STRING_POOL, VIEWS_STAY_VALID) {
+  events::string_pool pool;
+  std::vector<std::string_view> views;
+  for (int i = 0; i < 10000; i++)
+    views.push_back(pool.intern(std::to_string(i) + std::string(i % 50, 'x')));
+  views.push_back(pool.intern(std::string(100000, 'y')));
+
+  for (int i = 0; i < 10000; i++)
+    ASSERT_EQ(views[i], std::to_string(i) + std::string(i % 50, 'x'));
+  ASSERT_EQ(views.back(), std::string(100000, 'y'));
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "terminal_lines.hpp"
+
+using namespace std::chrono_literals;
+using descriptor = events::write_event::descriptor;
+
+static events::write_event write(pid_t pid, std::string data, events::time_point timestamp = {}, descriptor fd = descriptor::STDOUT) {
+  return {{pid, timestamp}, fd, std::move(data)};
+}
+
+struct collector {
+  std::vector<events::write_event> writes;
+  terminal_lines lines{[this](events::write_event const& e) { writes.push_back(e); }};
+
+  std::string output() const {
+    std::string result;
+    for (auto const& e : writes) result += e.data;
+    return result;
+  }
+};
+
+TEST(TERMINAL_LINES, COMPLETE_LINES_PASS_THROUGH) {
+  collector c;
+  c.lines.write(write(1, "\x1B[31merror\x1B[0m\nsecond\n"));
+  ASSERT_EQ(c.writes.size(), 1);
+  ASSERT_EQ(c.output(), "\x1B[31merror\x1B[0m\nsecond\n");
+}
+
+TEST(TERMINAL_LINES, PROGRESS_BAR) {
+  collector c;
+  for (int i = 0; i <= 100; i++)
+    c.lines.write(write(1, "\r[" + std::string(i / 10, '#') + std::string(10 - i / 10, ' ') + "] " + std::to_string(i) + "%"));
+  c.lines.write(write(1, "\ndone\n"));
+  ASSERT_EQ(c.writes.size(), 1);
+  ASSERT_EQ(c.output(), "[##########] 100%\ndone\n");
+}
+
+TEST(TERMINAL_LINES, ERASE_LINE) {
+  collector c;
+  c.lines.write(write(1, "downloading a long name\r\x1B[Kok\n"));
+  ASSERT_EQ(c.output(), "ok\n");
+}
+
+TEST(TERMINAL_LINES, STREAMS_ARE_SEPARATE) {
+  collector c;
+  c.lines.write(write(1, "abc"));
+  c.lines.write(write(2, "xyz\n"));
+  c.lines.write(write(1, "def", {}, descriptor::STDERR));
+  c.lines.write(write(1, "\r12\n"));
+  ASSERT_EQ(c.output(), "xyz\n12c\n");
+  c.lines.flush_all();
+  ASSERT_EQ(c.output(), "xyz\n12c\ndef");
+}
+
+TEST(TERMINAL_LINES, WINDOW) {
+  collector c;
+  events::time_point start{};
+  c.lines.write(write(1, "\r10%", start));
+  c.lines.write(write(1, "\r20%", start + 500ms));
+  c.lines.write(write(1, "\r30%", start + 1500ms));
+  c.lines.flush(1);
+  ASSERT_EQ(c.writes.size(), 2);
+  ASSERT_EQ(c.writes[0].data, "20%\n");
+  ASSERT_EQ(c.writes[0].timestamp, start);
+  ASSERT_EQ(c.writes[1].data, "30%");
+  ASSERT_EQ(c.writes[1].timestamp, start + 1500ms);
+}
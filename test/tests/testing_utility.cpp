@@ -13,7 +13,7 @@ struct overloaded : Ts... {
 template <class... Ts>
 overloaded(Ts...) -> overloaded<Ts...>;
 
-std::vector<events::event> run_bpf_provider(const std::vector<arg_t> &args) {
+std::vector<events::event> run_bpf_provider(const std::vector<arg_t> &args, bpf_provider_options options) {
   std::vector<char *> argv;
   for (auto &arg : args)
     std::visit(
@@ -23,7 +23,7 @@ std::vector<events::event> run_bpf_provider(const std::vector<arg_t> &args) {
         arg);
   argv.push_back(nullptr);
 
-  bpf_provider provider;
+  bpf_provider provider{options};
   provider.run(argv.data());
 
   std::vector<events::event> events;
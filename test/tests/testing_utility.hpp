@@ -4,6 +4,7 @@
 #include <functional>
 #include <variant>
 
+#include "bpf_provider.hpp"
 #include "events.hpp"
 
 using namespace std::string_literals;
@@ -11,7 +12,7 @@ using arg_t = std::variant<std::string, std::filesystem::path>;
 
 extern const std::filesystem::path programs, debugger;
 
-std::vector<events::event> run_bpf_provider(const std::vector<arg_t> &args);
+std::vector<events::event> run_bpf_provider(const std::vector<arg_t> &args, bpf_provider_options options = {});
 
 void run_bpf_provider(const std::vector<arg_t> &args,
                       std::function<void(events::fork_event)> fork_func,
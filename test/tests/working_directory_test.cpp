@@ -0,0 +1,20 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "testing_utility.hpp"
+
+TEST(PROGRAMS, WORKING_DIRECTORIES) {
+  std::vector<events::exec_event> execs;
+
+  run_bpf_provider(
+      {programs / "working_directories"}, [&](events::fork_event fork) {},
+      [&](events::exec_event exec) { execs.push_back(exec); },
+      [&](events::exit_event exit) {}, [&](events::write_event write) {});
+
+  ASSERT_EQ(execs.size(), 4);
+  // paths on other mounts are complete, repeated ones are resolved from the cache
+  ASSERT_EQ(execs[1].working_directory, "/dev/shm");
+  ASSERT_EQ(execs[2].working_directory, "/dev/shm");
+  ASSERT_EQ(execs[3].working_directory, "/");
+}